@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <iostream>
+#include "assembler.h"
+#include "parser.h"
+#include "converter.h"
+#include "relaxation.h"
+#include "linker.h"
+#include "stream_assembler.h"
+
+using namespace std;
+
+bool Assembler::assemble(string_view source) {
+    AssemblyStats* stats = options.stats;
+    symbolTable_.clear();
+    code_.clear();
+    pooledBytes_ = 0;
+    size_t* pooled = options.poolData ? &pooledBytes_ : nullptr;
+    if (!options.profileFile.empty() && loadedProfile != options.profileFile) {
+        if (!profile_.load(options.profileFile)) return false;
+        loadedProfile = options.profileFile;
+    }
+    const BlockProfile* profile = options.profileFile.empty() ? nullptr : &profile_;
+
+    if (options.twoPass) {
+        // Pass 1: Collect labels and directives
+        {
+            PhaseTimer timer(stats, "pass 1");
+            if (!parseFile(source, program_, symbolTable_, data_, true, false, options.jobs)) {
+                cerr << "Error: Failed in Pass 1 (Label Collection)." << endl;
+                return false;
+            }
+        }
+
+        // Pass 2: Parse instructions again for final conversion
+        PhaseTimer timer(stats, "pass 2");
+        if (!parseFile(source, program_, symbolTable_, data_, false, options.compress, 1, pooled, profile,
+                       &reorderedText)) {
+            cerr << "Error: Failed in Pass 2 (Instruction Parsing)." << endl;
+            return false;
+        }
+    }
+    else if (!options.cacheFile.empty()) {
+        if (loadedCacheFile != options.cacheFile) {
+            PhaseTimer timer(stats, "load cache");
+            cache_.load(options.cacheFile);
+            loadedCacheFile = options.cacheFile;
+        }
+        {
+            PhaseTimer timer(stats, "parse");
+            vector<TextLabel> textLabels;
+            // Labels are laid out even after a parse error, to report undefined ones too
+            bool parsed = cache_.parse(source, program_, symbolTable_, data_, textLabels);
+            if (!layoutText(program_, symbolTable_, textLabels, options.compress) || !parsed) {
+                cerr << "Error: Failed in incremental parsing." << endl;
+                return false;
+            }
+        }
+        if (stats != nullptr) {
+            stats->cachedBlocks += cache_.cachedBlocks;
+            stats->parsedBlocks += cache_.parsedBlocks;
+        }
+        PhaseTimer timer(stats, "save cache");
+        if (!cache_.save(options.cacheFile)) return false;
+    }
+    else {
+        PhaseTimer timer(stats, "parse");
+        // Labels resolved by layoutText
+        if (!parseFileSinglePass(source, program_, symbolTable_, data_, options.compress, pooled, profile,
+                                 &reorderedText)) {
+            cerr << "Error: Failed in single-pass parsing." << endl;
+            return false;
+        }
+    }
+
+    {
+        PhaseTimer timer(stats, "encode");
+        encodeProgram(program_, code_, options.jobs);
+    }
+
+    if (stats != nullptr) {
+        stats->lines += count(source.begin(), source.end(), '\n') + (!source.empty() && source.back() != '\n');
+        stats->instructions += program_.size();
+        stats->dataBytes += data_.size();
+        stats->pooledBytes += pooledBytes_;
+    }
+    return true;
+}
+
+bool Assembler::assembleFile(const string& filename) {
+    bool opened;
+    {
+        PhaseTimer timer(options.stats, "read");
+        opened = sourceFile.open(filename);
+    }
+    if (!opened) {
+        cerr << "Error: Could not open file " << filename << endl;
+        return false;
+    }
+    return assemble(sourceFile.text());
+}
+
+bool Assembler::assembleStream(const string& inputFilename, const string& outputFilename, OutputFormat format,
+                               bool annotate) {
+    program_.clear();
+    code_.clear();
+    return ::assembleStream(inputFilename, outputFilename, format, annotate, symbolTable_, data_, options.stats);
+}
+
+bool Assembler::assembleObject(const string& filename, ObjectFile& object) {
+    if (!sourceFile.open(filename)) {
+        cerr << "Error: Could not open file " << filename << endl;
+        return false;
+    }
+    string_view source = sourceFile.text();
+    program_.clear();
+    program_.setSource(source);
+    symbolTable_.clear();
+    data_.clear();
+    code_.clear();
+    vector<TextLabel> textLabels;
+    bool inData = false;
+    if (!parseBlock(source, 0, program_, symbolTable_, data_, inData, textLabels)) return false;
+    buildObject(program_, symbolTable_, data_, textLabels, object);
+    return true;
+}
+
+bool Assembler::link(const vector<ObjectFile>& objects, const vector<string>& names) {
+    code_.clear();
+    {
+        PhaseTimer timer(options.stats, "link");
+        if (!linkObjects(objects, names, program_, symbolTable_, data_, linkedText, options.compress)) return false;
+    }
+    PhaseTimer timer(options.stats, "encode");
+    encodeProgram(program_, code_, options.jobs);
+    if (options.stats != nullptr) {
+        options.stats->instructions += program_.size();
+        options.stats->dataBytes += data_.size();
+    }
+    return true;
+}
+
+long long Assembler::write(const string& filename, OutputFormat format, bool annotate) const {
+    PhaseTimer timer(options.stats, "write");
+    long long written;
+    if (format == OutputFormat::Text) written = writeTextOutput(filename, program_, code_, data_, annotate, options.jobs);
+    else if (format == OutputFormat::Binary) written = writeBinaryOutput(filename, code_, data_);
+    else written = writeElfOutput(filename, code_, data_, symbolTable_);
+    if (options.stats != nullptr && written > 0) options.stats->bytesWritten += written;
+    return written;
+}
@@ -0,0 +1,77 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "lexer.h"
+#include "program.h"
+#include "symbol_table.h"
+#include "data_segment.h"
+#include "output_writer.h"
+#include "stats.h"
+#include "assembly_cache.h"
+#include "object_file.h"
+#include "block_order.h"
+
+struct AssemblerOptions {
+    bool twoPass = false; // Label pass + instruction pass instead of single pass with fixups
+    unsigned jobs = 1;    // Threads used for the label pass, encoding and listing, 0 = all cores
+    bool compress = false; // Emit RV32C 16-bit forms where the operands fit
+    bool poolData = false; // Merge duplicate and suffix .rodata objects (see poolReadOnlyData; not with a cache)
+    std::string profileFile; // Reorder basic blocks by the counts in this profile (see reorderBlocks; not with a cache)
+    std::string cacheFile; // Incremental mode: reuse unchanged blocks parsed by an earlier run (single pass only)
+    AssemblyStats* stats = nullptr; // Phase timings and counters are recorded here when set
+};
+
+// Reusable in-process assembler. The program, symbol table, data image and
+// code buffers are kept between calls and only cleared, so assembling many
+// small snippets does not reallocate them. Results stay valid until the next
+// assemble call.
+class Assembler {
+private:
+    SourceBuffer sourceFile;
+    Program program_;
+    SymbolTable symbolTable_;
+    DataSegment data_;
+    std::vector<uint32_t> code_;
+    AssemblyCache cache_;
+    std::string loadedCacheFile; // Cache file whose records cache_ holds
+    std::string linkedText;      // Statements of the linked modules, the listing source after link()
+    size_t pooledBytes_ = 0;
+    BlockProfile profile_;
+    std::string loadedProfile; // Profile file whose counts profile_ holds
+    std::string reorderedText; // Statements of the reordered blocks, the listing source after reordering
+
+public:
+    AssemblerOptions options;
+
+    // Assemble source text. The text must outlive the results, since the
+    // listing refers to it.
+    bool assemble(std::string_view source);
+    // Assemble a file ("-" for stdin); the file contents are owned by the assembler
+    bool assembleFile(const std::string& filename);
+
+    // Assemble a file as a stream (see assembleStream), writing the output as
+    // it goes. No program is kept: afterwards only symbols() and data() hold
+    // results.
+    bool assembleStream(const std::string& inputFilename, const std::string& outputFilename, OutputFormat format,
+                        bool annotate);
+
+    // Assemble a file into a relocatable object instead of a program
+    bool assembleObject(const std::string& filename, ObjectFile& object);
+    // Link objects (see linkObjects) and encode the result as the current program
+    bool link(const std::vector<ObjectFile>& objects, const std::vector<std::string>& names);
+
+    // Write the current results in the given format; returns bytes written or -1
+    long long write(const std::string& filename, OutputFormat format, bool annotate) const;
+
+    const Program& program() const { return program_; }
+    const std::vector<uint32_t>& code() const { return code_; }
+    const DataSegment& data() const { return data_; }
+    const SymbolTable& symbols() const { return symbolTable_; }
+    // Data bytes saved by options.poolData in the last assemble call
+    size_t pooledBytes() const { return pooledBytes_; }
+};
+
+#endif
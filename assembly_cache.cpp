@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "assembly_cache.h"
+#include "parser.h"
+
+using namespace std;
+
+namespace {
+
+constexpr char cacheMagic[8] = {'R', 'V', 'A', 'S', 'M', 'C', 'C', 'H'};
+constexpr uint32_t cacheVersion = 4;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t tableSize; // instructionCount and mnemonicSeed, so records with stale ids are dropped
+    uint32_t tableSeed;
+    uint32_t instructions; // Size of the last parsed program, to reserve space up front
+};
+
+// Followed by the arrays ids, rd, rs1, rs2, immediates, symbols (local
+// indices), modifiers, sourceOffsets (from the block start), sourceLengths;
+// the text labels' symbols and indices; each symbol's name length and data
+// label offset and constant value; each symbol's flags; the names; the data
+// bytes
+struct RecordHeader {
+    uint64_t key;
+    uint32_t sourceBytes;
+    uint32_t instructions;
+    uint32_t textLabels;
+    uint32_t symbols;
+    uint32_t nameBytes;
+    uint32_t dataBytes;
+    uint8_t entryInData;
+    uint8_t exitInData;
+    uint8_t padding[6];
+};
+
+constexpr uint32_t noDataLabel = 0xFFFFFFFF;
+
+// Bytes per instruction in a record, one value in each instruction array
+constexpr size_t instructionBytes = 4 * sizeof(uint8_t) + sizeof(int32_t) + sizeof(SymbolId) + sizeof(Modifier) +
+                                    sizeof(uint32_t) + sizeof(uint16_t);
+
+// Offset of each part of a record from its start, and the record's size
+struct RecordLayout {
+    size_t labelSymbols, labelIndices, nameLengths, dataOffsets, constants, flags, names, bytes, size;
+
+    explicit RecordLayout(const RecordHeader& header) {
+        labelSymbols = sizeof(RecordHeader) + size_t(header.instructions) * instructionBytes;
+        labelIndices = labelSymbols + size_t(header.textLabels) * 4;
+        nameLengths = labelIndices + size_t(header.textLabels) * 4;
+        dataOffsets = nameLengths + size_t(header.symbols) * 4;
+        constants = dataOffsets + size_t(header.symbols) * 4;
+        flags = constants + size_t(header.symbols) * 4;
+        names = flags + header.symbols;
+        bytes = names + header.nameBytes;
+        size = bytes + header.dataBytes;
+    }
+};
+
+enum : uint8_t { recordGlobal = 1, recordConstant = 2 };
+
+// 64-bit hash of a block, 8 bytes at a time, seeded with the starting section
+// and the constants defined before the block, which its values may depend on
+uint64_t hashBlock(string_view block, bool inData, uint64_t constants) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull ^ (block.size() << 1) ^ (inData ? 1 : 0) ^ (constants << 1);
+    size_t i = 0;
+    for (; i + 8 <= block.size(); i += 8) {
+        uint64_t word;
+        memcpy(&word, block.data() + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, block.data() + i, block.size() - i);
+    hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ull;
+    return hash ^ (hash >> 32);
+}
+
+template <typename T>
+void putArray(vector<uint8_t>& out, const T* values, size_t count) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+    out.insert(out.end(), bytes, bytes + count * sizeof(T));
+}
+
+// Copy count values out of a record and advance the cursor
+template <typename T>
+void getArray(const uint8_t*& cursor, T* values, size_t count) {
+    memcpy(values, cursor, count * sizeof(T));
+    cursor += count * sizeof(T);
+}
+
+// Length of the block starting at position: up to the next line, after its
+// first, that contains a ':' and so may define a label. Any line boundary
+// would do; cutting at labels keeps an edit from moving later boundaries.
+size_t blockLength(string_view source, size_t position) {
+    const char* begin = source.data() + position;
+    const char* end = source.data() + source.size();
+    const char* newline = static_cast<const char*>(memchr(begin, '\n', end - begin));
+    if (newline == nullptr) return end - begin;
+    const char* colon = static_cast<const char*>(memchr(newline + 1, ':', end - newline - 1));
+    if (colon == nullptr) return end - begin;
+    while (colon[-1] != '\n') colon--;
+    return colon - begin;
+}
+
+} // namespace
+
+void AssemblyCache::load(const string& filename) {
+    records.clear();
+    offsets.clear();
+    savedFile.clear();
+    savedBytes = 0;
+    ifstream file(filename, ios::binary | ios::ate);
+    if (!file.is_open()) return;
+    size_t size = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    FileHeader header;
+    if (size < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) return;
+    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+        header.tableSize != instructionCount || header.tableSeed != mnemonicSeed) {
+        return;
+    }
+    records.resize(size - sizeof(header));
+    if (!file.read(reinterpret_cast<char*>(records.data()), records.size())) records.clear();
+
+    // Index the records, giving up on the whole file if one is truncated.
+    // Appended records replace earlier ones with the same key.
+    for (size_t offset = 0; offset < records.size();) {
+        RecordHeader record;
+        if (records.size() - offset < sizeof(record)) break;
+        memcpy(&record, records.data() + offset, sizeof(record));
+        size_t length = RecordLayout(record).size;
+        if (records.size() - offset < length) break;
+        offsets[record.key] = Entry{offset, 0};
+        offset += length;
+        if (offset == records.size()) {
+            savedFile = filename;
+            savedBytes = records.size();
+            lastInstructions = header.instructions;
+            return;
+        }
+    }
+    records.clear();
+    offsets.clear();
+}
+
+// Append the records added since the last save, or rewrite the file with
+// just the records of the last parse once stale ones make up most of it
+bool AssemblyCache::save(const string& filename) {
+    bool append = filename == savedFile && liveBytes * 2 >= records.size();
+    if (!append) {
+        vector<uint8_t> live;
+        live.reserve(liveBytes);
+        for (auto entry = offsets.begin(); entry != offsets.end();) {
+            if (entry->second.lastParse != parseCount) {
+                entry = offsets.erase(entry);
+                continue;
+            }
+            RecordHeader header;
+            memcpy(&header, records.data() + entry->second.offset, sizeof(header));
+            const uint8_t* record = records.data() + entry->second.offset;
+            entry->second.offset = live.size();
+            live.insert(live.end(), record, record + RecordLayout(header).size);
+            ++entry;
+        }
+        records.swap(live);
+        savedBytes = 0;
+    }
+
+    fstream file(filename, ios::binary | ios::in | ios::out | (append ? ios::openmode() : ios::trunc));
+    if (!file.is_open()) {
+        cerr << "Error: Could not write cache file " << filename << endl;
+        savedFile.clear();
+        return false;
+    }
+    FileHeader header = {};
+    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.tableSize = static_cast<uint32_t>(instructionCount);
+    header.tableSeed = mnemonicSeed;
+    header.instructions = static_cast<uint32_t>(lastInstructions);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.seekp(sizeof(header) + savedBytes);
+    file.write(reinterpret_cast<const char*>(records.data() + savedBytes), records.size() - savedBytes);
+    if (!file) {
+        cerr << "Error: Could not write cache file " << filename << endl;
+        savedFile.clear();
+        return false;
+    }
+    savedFile = filename;
+    savedBytes = records.size();
+    return true;
+}
+
+// Serialize the block just parsed into the scratch state. Symbols are listed
+// in id order, which for a fresh table is their order of first use.
+void AssemblyCache::appendRecord(vector<uint8_t>& out, uint64_t key, string_view block, bool entryInData,
+                                 bool exitInData) {
+    const Program& p = scratchProgram;
+    RecordHeader header = {};
+    header.key = key;
+    header.sourceBytes = static_cast<uint32_t>(block.size());
+    header.instructions = static_cast<uint32_t>(p.size());
+    header.textLabels = static_cast<uint32_t>(scratchLabels.size());
+    header.symbols = static_cast<uint32_t>(scratchSymbols.size());
+    header.dataBytes = static_cast<uint32_t>(scratchData.size());
+    header.entryInData = entryInData;
+    header.exitInData = exitInData;
+    for (SymbolId id = 0; id < scratchSymbols.size(); id++) header.nameBytes += scratchSymbols.name(id).size();
+    putArray(out, &header, 1);
+
+    putArray(out, p.ids.data(), p.size());
+    putArray(out, p.rd.data(), p.size());
+    putArray(out, p.rs1.data(), p.size());
+    putArray(out, p.rs2.data(), p.size());
+    putArray(out, p.immediates.data(), p.size());
+    putArray(out, p.symbols.data(), p.size());
+    putArray(out, p.modifiers.data(), p.size());
+    putArray(out, p.sourceOffsets.data(), p.size());
+    putArray(out, p.sourceLengths.data(), p.size());
+    for (const TextLabel& label : scratchLabels) putArray(out, &label.symbol, 1);
+    for (const TextLabel& label : scratchLabels) putArray(out, &label.index, 1);
+
+    // A symbol that is a text label gets its address from layoutText, so
+    // only data labels carry an offset
+    vector<uint8_t> textLabel(scratchSymbols.size(), 0);
+    for (const TextLabel& label : scratchLabels) textLabel[label.symbol] = 1;
+    for (SymbolId id = 0; id < scratchSymbols.size(); id++) {
+        uint32_t length = static_cast<uint32_t>(scratchSymbols.name(id).size());
+        putArray(out, &length, 1);
+    }
+    for (SymbolId id = 0; id < scratchSymbols.size(); id++) {
+        uint32_t offset = noDataLabel;
+        if (scratchSymbols.isLabel(id) && !textLabel[id]) offset = scratchSymbols.address(id) - DataSegment::baseAddress;
+        putArray(out, &offset, 1);
+    }
+    for (SymbolId id = 0; id < scratchSymbols.size(); id++) {
+        int32_t value = scratchSymbols.isConstant(id) ? scratchSymbols.constant(id) : 0;
+        putArray(out, &value, 1);
+    }
+    for (SymbolId id = 0; id < scratchSymbols.size(); id++) {
+        uint8_t flags = (scratchSymbols.isGlobal(id) ? recordGlobal : 0) |
+                        (scratchSymbols.isConstant(id) ? recordConstant : 0);
+        putArray(out, &flags, 1);
+    }
+    for (SymbolId id = 0; id < scratchSymbols.size(); id++) {
+        string_view name = scratchSymbols.name(id);
+        putArray(out, name.data(), name.size());
+    }
+    putArray(out, scratchData.data(), scratchData.size());
+}
+
+// Whether a block's record defines a label that is already defined
+static bool redefinesLabel(const uint8_t* record, const SymbolTable& symbolTable) {
+    RecordHeader header;
+    memcpy(&header, record, sizeof(header));
+    RecordLayout layout(header);
+    const uint8_t* labelSymbols = record + layout.labelSymbols;
+    const uint8_t* nameLengths = record + layout.nameLengths;
+    const uint8_t* dataOffsets = record + layout.dataOffsets;
+    const char* names = reinterpret_cast<const char*>(record + layout.names);
+    vector<uint8_t> textLabel(header.symbols, 0);
+    for (uint32_t l = 0; l < header.textLabels; l++) {
+        uint32_t symbol;
+        memcpy(&symbol, labelSymbols + l * 4, 4);
+        textLabel[symbol] = 1;
+    }
+    for (uint32_t s = 0; s < header.symbols; s++) {
+        uint32_t length, offset;
+        memcpy(&length, nameLengths + s * 4, 4);
+        memcpy(&offset, dataOffsets + s * 4, 4);
+        string_view name(names, length);
+        names += length;
+        if (offset == noDataLabel && !textLabel[s]) continue;
+        SymbolId id = symbolTable.find(name);
+        if (id != noSymbolId && symbolTable.isLabel(id)) return true;
+    }
+    return false;
+}
+
+// Append a block's record to the program, symbol table and data image, as
+// if the block had been parsed in place
+static void replayRecord(const uint8_t* record, size_t blockOffset, Program& program, SymbolTable& symbolTable,
+                         DataSegment& data, vector<TextLabel>& textLabels, vector<SymbolId>& ids) {
+    RecordHeader header;
+    memcpy(&header, record, sizeof(header));
+    const uint8_t* cursor = record + sizeof(header);
+    size_t base = program.size();
+    size_t count = header.instructions;
+    program.resize(base + count);
+    getArray(cursor, program.ids.data() + base, count);
+    getArray(cursor, program.rd.data() + base, count);
+    getArray(cursor, program.rs1.data() + base, count);
+    getArray(cursor, program.rs2.data() + base, count);
+    getArray(cursor, program.immediates.data() + base, count);
+    getArray(cursor, program.symbols.data() + base, count);
+    getArray(cursor, program.modifiers.data() + base, count);
+    getArray(cursor, program.sourceOffsets.data() + base, count);
+    getArray(cursor, program.sourceLengths.data() + base, count);
+    RecordLayout layout(header);
+    const uint8_t* labelSymbols = record + layout.labelSymbols;
+    const uint8_t* labelIndices = record + layout.labelIndices;
+    const uint8_t* nameLengths = record + layout.nameLengths;
+    const uint8_t* dataOffsets = record + layout.dataOffsets;
+    const uint8_t* constants = record + layout.constants;
+    const uint8_t* flags = record + layout.flags;
+    const char* names = reinterpret_cast<const char*>(record + layout.names);
+    const uint8_t* bytes = record + layout.bytes;
+
+    // Intern in order of first use, so new symbols get the ids a clean parse gives them
+    uint32_t dataStart = data.address();
+    ids.resize(header.symbols);
+    for (uint32_t s = 0; s < header.symbols; s++) {
+        uint32_t length, offset;
+        memcpy(&length, nameLengths + s * 4, 4);
+        memcpy(&offset, dataOffsets + s * 4, 4);
+        string_view name(names, length);
+        names += length;
+        ids[s] = offset == noDataLabel ? symbolTable.intern(name) : symbolTable.addLabel(name, dataStart + offset);
+        if (flags[s] & recordGlobal) symbolTable.addGlobal(name);
+        if (flags[s] & recordConstant) {
+            int32_t value;
+            memcpy(&value, constants + s * 4, 4);
+            symbolTable.addConstant(name, value);
+        }
+    }
+    data.writeBytes(bytes, header.dataBytes);
+
+    for (size_t i = base; i < base + count; i++) {
+        if (program.symbols[i] != noSymbolId) program.symbols[i] = ids[program.symbols[i]];
+        program.sourceOffsets[i] += static_cast<uint32_t>(blockOffset);
+    }
+    for (uint32_t l = 0; l < header.textLabels; l++) {
+        TextLabel label;
+        memcpy(&label.symbol, labelSymbols + l * 4, 4);
+        memcpy(&label.index, labelIndices + l * 4, 4);
+        label.symbol = ids[label.symbol];
+        label.index += static_cast<uint32_t>(base);
+        symbolTable.addLabel(symbolTable.name(label.symbol), label.index * 4);
+        textLabels.push_back(label);
+    }
+}
+
+bool AssemblyCache::parse(string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                          vector<TextLabel>& textLabels) {
+    program.clear();
+    program.setSource(source);
+    program.reserve(lastInstructions);
+    data.clear();
+    cachedBlocks = parsedBlocks = 0;
+    liveBytes = 0;
+    parseCount++;
+
+    // A changed block sees the constants defined before it
+    scratchSymbols.setOuterScope(&symbolTable);
+    vector<SymbolId> ids;
+    bool ok = true; // Parsing goes on past a bad block, so every error is reported
+    bool inData = false;
+    uint32_t line = 0;
+    for (size_t position = 0; position < source.size();) {
+        string_view block = source.substr(position, blockLength(source, position));
+        uint32_t firstLine = line;
+        line += static_cast<uint32_t>(count(block.begin(), block.end(), '\n'));
+        position += block.size();
+
+        // Data alignment depends on where the block lands, so such blocks are
+        // always parsed in place
+        if (block.find("align") != string_view::npos) {
+            ok = parseBlock(block, firstLine, program, symbolTable, data, inData, textLabels) && ok;
+            parsedBlocks++;
+            continue;
+        }
+
+        uint64_t key = hashBlock(block, inData, symbolTable.constantsHash());
+        auto entry = offsets.find(key);
+        RecordHeader header;
+        if (entry != offsets.end()) memcpy(&header, records.data() + entry->second.offset, sizeof(header));
+        if (entry != offsets.end() && header.sourceBytes == block.size() && header.entryInData == inData) {
+            cachedBlocks++;
+        } else {
+            scratchProgram.clear();
+            scratchProgram.setSource(block);
+            scratchSymbols.clear();
+            scratchData.clear();
+            scratchLabels.clear();
+            bool exitInData = inData;
+            // The messages are held back in case the block is parsed again in place, which reports them itself
+            ostringstream messages;
+            streambuf* console = cerr.rdbuf(messages.rdbuf());
+            bool parsed = parseBlock(block, firstLine, scratchProgram, scratchSymbols, scratchData, exitInData,
+                                     scratchLabels);
+            cerr.rdbuf(console);
+            if (!parsed) {
+                // A bad block is not cached, but its labels and good lines go in as
+                // a clean parse keeps them, so later blocks report no extra errors
+                ok = false;
+                parsedBlocks++;
+                vector<uint8_t> failed;
+                appendRecord(failed, key, block, inData, exitInData);
+                if (redefinesLabel(failed.data(), symbolTable)) {
+                    parseBlock(block, firstLine, program, symbolTable, data, inData, textLabels);
+                } else {
+                    cerr << messages.str();
+                    replayRecord(failed.data(), block.data() - source.data(), program, symbolTable, data, textLabels,
+                                 ids);
+                    inData = exitInData;
+                }
+                continue;
+            }
+            cerr << messages.str();
+            size_t offset = records.size();
+            appendRecord(records, key, block, inData, exitInData);
+            entry = offsets.insert_or_assign(key, Entry{offset, 0}).first;
+            memcpy(&header, records.data() + offset, sizeof(header));
+            parsedBlocks++;
+        }
+        if (entry->second.lastParse != parseCount) {
+            entry->second.lastParse = parseCount;
+            liveBytes += RecordLayout(header).size;
+        }
+
+        // A label defined again is reported the way a clean parse reports it
+        if (redefinesLabel(records.data() + entry->second.offset, symbolTable)) {
+            ok = parseBlock(block, firstLine, program, symbolTable, data, inData, textLabels) && ok;
+            continue;
+        }
+        replayRecord(records.data() + entry->second.offset, block.data() - source.data(), program, symbolTable,
+                     data, textLabels, ids);
+        inData = header.exitInData;
+    }
+    lastInstructions = program.size();
+    return ok;
+}
@@ -0,0 +1,65 @@
+#ifndef ASSEMBLY_CACHE_H
+#define ASSEMBLY_CACHE_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "program.h"
+#include "symbol_table.h"
+#include "data_segment.h"
+#include "relaxation.h"
+
+// On-disk cache of parsed source blocks for incremental reassembly. The
+// source is cut into blocks at every line that defines a label, and each
+// block is keyed by a hash of its text and the section it starts in. A
+// block's record holds its instructions, text labels and data bytes relative
+// to the block start, with symbols by name in order of first use, so it can
+// be replayed at any position. Parsing through the cache re-parses only the
+// blocks whose text changed; layout and label resolution then run over the
+// whole program as usual, so the output is identical to a clean build.
+//
+// Records are stored in native byte order: the file is a local build
+// artifact, and one that fails to load is simply ignored.
+class AssemblyCache {
+public:
+    // Load a cache file; a missing, stale or damaged file leaves the cache empty
+    void load(const std::string& filename);
+    // Write the records added by the last parse. Records of blocks that no
+    // longer occur are dropped once they make up half the file.
+    bool save(const std::string& filename);
+
+    // Single-pass parse of source, replaying unchanged blocks (see
+    // parseFileSinglePass); text labels are left for layoutText
+    bool parse(std::string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data,
+               std::vector<TextLabel>& textLabels);
+
+    size_t cachedBlocks = 0; // Blocks replayed by the last parse
+    size_t parsedBlocks = 0; // Blocks parsed by the last parse
+
+private:
+    struct Entry {
+        size_t offset;      // Into records
+        uint32_t lastParse; // parseCount of the last parse that used the record
+    };
+
+    std::vector<uint8_t> records;             // Serialized block records, back to back
+    std::unordered_map<uint64_t, Entry> offsets; // By block key
+    uint32_t parseCount = 0;
+    size_t liveBytes = 0;        // Size of the records used by the last parse
+    size_t lastInstructions = 0; // Program size of the last parse
+    std::string savedFile;       // File holding the first savedBytes of records
+    size_t savedBytes = 0;
+
+    // A changed block is parsed into these first, so that its record sees the
+    // block on its own
+    Program scratchProgram;
+    SymbolTable scratchSymbols;
+    DataSegment scratchData;
+    std::vector<TextLabel> scratchLabels;
+
+    void appendRecord(std::vector<uint8_t>& out, uint64_t key, std::string_view block, bool entryInData,
+                      bool exitInData);
+};
+
+#endif
@@ -0,0 +1,130 @@
+// Stage-by-stage assembler benchmark on generated RV32IM programs.
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -pthread -o assembler_bench bench/assembler_bench.cpp bench/workload_generator.cpp
+//       lexer.cpp line_scanner.cpp parser.cpp expression.cpp relaxation.cpp program.cpp symbol_table.cpp
+//       data_segment.cpp data_pool.cpp block_order.cpp converter.cpp compressed.cpp output_writer.cpp stats.cpp
+// Usage: assembler_bench [--sizes 1000,100000,10000000] [--repeat N] [--emit lines file.asm]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "workload_generator.h"
+#include "../lexer.h"
+#include "../parser.h"
+#include "../converter.h"
+#include "../output_writer.h"
+
+using namespace std;
+
+// Best-of-N wall time of one stage, in seconds
+static double timeStage(int repeat, const function<void()>& stage) {
+    double best = 1e30;
+    for (int i = 0; i < repeat; i++) {
+        auto start = chrono::steady_clock::now();
+        stage();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+static void printRow(const string& stage, size_t lines, size_t items, double seconds) {
+    cout << "  " << left << setw(14) << stage << right << fixed << setprecision(3) << setw(12) << seconds * 1e3
+         << " ms" << setprecision(0) << setw(16) << lines / seconds << " lines/s" << setw(16) << items / seconds
+         << " items/s\n";
+}
+
+static void runSize(size_t lines, int repeat) {
+    WorkloadOptions workload;
+    workload.lines = lines;
+    string source = generateWorkload(workload);
+    cout << lines << " lines (" << source.size() / 1024 << " KiB of source)\n";
+
+    // Lexing only
+    size_t tokens = 0;
+    double lexTime = timeStage(repeat, [&] {
+        Lexer lexer(source);
+        SourceLine line;
+        tokens = 0;
+        while (lexer.next(line)) tokens += line.operandCount + 1;
+    });
+    printRow("lex", lines, tokens, lexTime);
+
+    // parseFile, single pass with fixups
+    Program program;
+    SymbolTable symbolTable;
+    DataSegment data;
+    double parseTime = timeStage(repeat, [&] {
+        symbolTable.clear();
+        if (!parseFileSinglePass(source, program, symbolTable, data)) exit(1);
+    });
+    printRow("parse", lines, program.size(), parseTime);
+
+    // Symbol lookup by name for every label
+    vector<string> labels;
+    for (SymbolId id = 0; id < symbolTable.size(); id++) {
+        if (symbolTable.isLabel(id)) labels.emplace_back(symbolTable.name(id));
+    }
+    uint64_t checksum = 0;
+    double lookupTime = timeStage(repeat, [&] {
+        for (const string& label : labels) checksum += symbolTable.getAddress(label);
+    });
+    printRow("symbol lookup", lines, labels.size(), lookupTime);
+
+    // convertToMachineCode on one thread
+    vector<uint32_t> code;
+    double encodeTime = timeStage(repeat, [&] { encodeProgram(program, code, 1); });
+    printRow("encode", lines, code.size(), encodeTime);
+
+    // Output writers
+    string textFile = "/tmp/assembler_bench.mc";
+    string binFile = "/tmp/assembler_bench.bin";
+    long long written = 0;
+    double textTime = timeStage(repeat, [&] { written = writeTextOutput(textFile, program, code, data, false, 1); });
+    printRow("write mc", lines, written, textTime);
+    double binTime = timeStage(repeat, [&] { written = writeBinaryOutput(binFile, code, data); });
+    printRow("write bin", lines, written, binTime);
+    remove(textFile.c_str());
+    remove(binFile.c_str());
+    remove((binFile + ".data").c_str());
+
+    // Printed so that the lookups are not optimized away
+    cout << "  (lookup checksum " << checksum << ")\n";
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> sizes = {1000, 100000};
+    int repeat = 3;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            string list = argv[++i];
+            for (size_t start = 0; start < list.size();) {
+                size_t comma = list.find(',', start);
+                sizes.push_back(stoull(list.substr(start, comma - start)));
+                start = comma == string::npos ? list.size() : comma + 1;
+            }
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = max(1, atoi(argv[++i]));
+        } else if (arg == "--emit" && i + 2 < argc) {
+            // Write a generated program instead of benchmarking
+            WorkloadOptions workload;
+            workload.lines = stoull(argv[++i]);
+            ofstream out(argv[++i], ios::binary);
+            out << generateWorkload(workload);
+            return out.good() ? 0 : 1;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--sizes 1000,100000,10000000] [--repeat N] [--emit lines file.asm]" << endl;
+            return 1;
+        }
+    }
+
+    for (size_t lines : sizes) runSize(lines, repeat);
+    return 0;
+}
@@ -0,0 +1,70 @@
+// Symbol table lookup throughput for large label counts.
+// Build from the repository root:
+//   g++ -std=c++17 -O2 -o symbol_bench bench/symbol_bench.cpp symbol_table.cpp
+// Usage: symbol_bench [labels] [lookups]
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../symbol_table.h"
+
+using namespace std;
+
+static double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t labelCount = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    size_t lookupCount = argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000000;
+
+    // One label per basic block, named the way generated code names them
+    vector<string> labels;
+    labels.reserve(labelCount);
+    for (size_t i = 0; i < labelCount; i++) labels.push_back("func" + to_string(i / 16) + "_bb" + to_string(i % 16));
+
+    mt19937 random(42);
+    vector<uint32_t> order(lookupCount);
+    for (uint32_t& index : order) index = random() % labelCount;
+
+    // Hashed, interned table
+    SymbolTable symbolTable;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < labelCount; i++) symbolTable.addLabel(labels[i], static_cast<uint32_t>(i * 4));
+    double insertTime = secondsSince(start);
+
+    uint64_t checksum = 0;
+    start = chrono::steady_clock::now();
+    for (uint32_t index : order) checksum += symbolTable.getAddress(labels[index]);
+    double lookupTime = secondsSince(start);
+
+    // Lookups by id once a reference has been interned
+    vector<SymbolId> ids(labelCount);
+    for (size_t i = 0; i < labelCount; i++) ids[i] = symbolTable.find(labels[i]);
+    start = chrono::steady_clock::now();
+    for (uint32_t index : order) checksum += symbolTable.address(ids[index]);
+    double idTime = secondsSince(start);
+
+    // std::map baseline, as used before the hashed table
+    map<string, uint32_t, less<>> baseline;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < labelCount; i++) baseline[labels[i]] = static_cast<uint32_t>(i * 4);
+    double mapInsertTime = secondsSince(start);
+    start = chrono::steady_clock::now();
+    for (uint32_t index : order) checksum += baseline.find(labels[index])->second;
+    double mapLookupTime = secondsSince(start);
+
+    auto rate = [&](double seconds) { return lookupCount / seconds / 1e6; };
+    cout << "labels: " << labelCount << ", lookups: " << lookupCount << "\n";
+    cout << "hashed insert:    " << insertTime * 1e3 << " ms\n";
+    cout << "hashed by name:   " << rate(lookupTime) << " M lookups/s\n";
+    cout << "hashed by id:     " << rate(idTime) << " M lookups/s\n";
+    cout << "std::map insert:  " << mapInsertTime * 1e3 << " ms\n";
+    cout << "std::map by name: " << rate(mapLookupTime) << " M lookups/s\n";
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <random>
+#include "workload_generator.h"
+
+using namespace std;
+
+static const char* const rMnemonics[] = {"add", "sub", "xor", "or", "and", "sll", "slt",
+                                         "sra", "srl", "mul", "div", "rem"};
+static const char* const iMnemonics[] = {"addi", "andi", "ori"};
+static const char* const loadMnemonics[] = {"lb", "lh", "lw"};
+static const char* const storeMnemonics[] = {"sb", "sh", "sw"};
+static const char* const branchMnemonics[] = {"beq", "bne", "blt", "bge"};
+
+template <size_t N>
+static const char* pick(mt19937& random, const char* const (&names)[N]) {
+    return names[random() % N];
+}
+
+static void appendRegister(string& out, mt19937& random) {
+    out += 'x';
+    out += to_string(random() % 32);
+}
+
+string generateWorkload(const WorkloadOptions& options) {
+    mt19937 random(options.seed);
+    string out;
+    out.reserve(options.lines * 24);
+
+    size_t dataLines = options.lines * options.dataPercent / 100;
+    size_t textLines = options.lines - dataLines;
+    size_t blocks = textLines / (options.blockLength + 1) + 1;
+
+    // Data section: word tables and strings
+    out += ".data\n";
+    for (size_t i = 0; i < dataLines; i++) {
+        if (i % 8 == 0) out += "table" + to_string(i / 8) + ": ";
+        if (random() % 4 == 0) {
+            out += ".asciiz \"message number " + to_string(random() % 1000) + "\"\n";
+        } else {
+            out += ".word";
+            for (int j = 0; j < 4; j++) out += ' ' + to_string(static_cast<int32_t>(random()));
+            out += '\n';
+        }
+    }
+
+    // Text section: one label per basic block
+    out += ".text\n";
+    size_t block = 0;
+    unsigned untilLabel = 0;
+    for (size_t i = 0; i < textLines; i++) {
+        if (untilLabel == 0) {
+            out += "bb" + to_string(block++) + ":\n";
+            untilLabel = 1 + random() % (2 * options.blockLength);
+            continue;
+        }
+        untilLabel--;
+
+        unsigned kind = random() % 100;
+        if (kind < 35) {
+            out += pick(random, rMnemonics);
+            out += ' ';
+            appendRegister(out, random);
+            out += ", ";
+            appendRegister(out, random);
+            out += ", ";
+            appendRegister(out, random);
+        } else if (kind < 55) {
+            out += pick(random, iMnemonics);
+            out += ' ';
+            appendRegister(out, random);
+            out += ", ";
+            appendRegister(out, random);
+            out += ", " + to_string(static_cast<int>(random() % 4096) - 2048);
+        } else if (kind < 65) {
+            out += pick(random, loadMnemonics);
+            out += ' ';
+            appendRegister(out, random);
+            out += ", " + to_string(4 * (random() % 64)) + '(';
+            appendRegister(out, random);
+            out += ')';
+        } else if (kind < 73) {
+            out += pick(random, storeMnemonics);
+            out += ' ';
+            appendRegister(out, random);
+            out += ", " + to_string(4 * (random() % 64)) + '(';
+            appendRegister(out, random);
+            out += ')';
+        } else if (kind < 88) {
+            // Mostly forward branches to a nearby block, some loops back
+            size_t target = block + random() % 8;
+            if (random() % 4 == 0 && block > 0) target = block - 1 - random() % min<size_t>(block, 4);
+            if (target >= blocks) target = blocks - 1;
+            out += pick(random, branchMnemonics);
+            out += ' ';
+            appendRegister(out, random);
+            out += ", ";
+            appendRegister(out, random);
+            out += ", bb" + to_string(target);
+        } else if (kind < 91) {
+            out += random() % 2 ? "lui " : "auipc ";
+            appendRegister(out, random);
+            out += ", " + to_string(random() % 0x100000);
+        } else if (kind < 94 && dataLines >= 8) {
+            // Absolute address of a table: lui %hi, then addi, a load or a store with %lo
+            string table = "table" + to_string(random() % (dataLines / 8));
+            string base = "x" + to_string(1 + random() % 31);
+            out += "lui " + base + ", %hi(" + table + ")\n";
+            unsigned use = random() % 3;
+            if (use == 0) {
+                out += "addi " + base + ", " + base + ", %lo(" + table + ")";
+            } else {
+                out += string(use == 1 ? "lw x" : "sw x") + to_string(random() % 32);
+                out += ", %lo(" + table + ")(" + base + ")";
+            }
+        } else {
+            size_t target = block + random() % 32;
+            if (target >= blocks) target = blocks - 1;
+            out += "jal ";
+            appendRegister(out, random);
+            out += ", bb" + to_string(target);
+        }
+        out += '\n';
+    }
+
+    // Make sure every branch target exists
+    while (block < blocks) out += "bb" + to_string(block++) + ":\n";
+    return out;
+}
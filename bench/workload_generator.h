@@ -0,0 +1,20 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+#include <cstdint>
+#include <string>
+
+// Shape of a synthetic RV32IM program
+struct WorkloadOptions {
+    size_t lines = 1000;            // Approximate number of source lines
+    uint32_t seed = 1;
+    unsigned blockLength = 6;       // Average instructions per labelled basic block
+    unsigned dataPercent = 5;       // Share of lines spent on .word/.asciiz data
+};
+
+// Generate a realistic assembly program: a .data section with .word tables
+// and .asciiz strings, then a .text section mixing R/I/S/SB/U/UJ instructions
+// with dense labels, forward and backward branches, and %hi/%lo pairs that
+// load table addresses.
+std::string generateWorkload(const WorkloadOptions& options);
+
+#endif
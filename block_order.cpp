@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include "block_order.h"
+#include "lexer.h"
+#include "debug_log.h"
+
+using namespace std;
+
+static constexpr uint8_t idJal = instructionId("jal");
+static constexpr uint8_t idJalr = instructionId("jalr");
+
+void BlockProfile::clear() {
+    blocks.clear();
+    edges.clear();
+}
+
+bool BlockProfile::load(const string& filename) {
+    clear();
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open profile " << filename << endl;
+        return false;
+    }
+    string line;
+    for (size_t lineNumber = 1; getline(file, line); lineNumber++) {
+        string_view cursor = string_view(line).substr(0, line.find('#'));
+        string_view fields[4];
+        int count = 0;
+        while (count < 4 && nextToken(cursor, fields[count])) count++;
+        if (count == 0) continue;
+        uint64_t value = 0;
+        string_view number = fields[count - 1];
+        auto result = from_chars(number.data(), number.data() + number.size(), value);
+        if (count < 2 || count > 3 || result.ec != errc() || result.ptr != number.data() + number.size()) {
+            cerr << "Error: Invalid profile entry on line " << lineNumber << " of " << filename << endl;
+            return false;
+        }
+        if (count == 2) blocks[string(fields[0])] += value;
+        else edges[{string(fields[0]), string(fields[1])}] += value;
+    }
+    return true;
+}
+
+long long BlockProfile::save(const string& filename) const {
+    ofstream file(filename);
+    if (!file.is_open()) return -1;
+    // Sorted by name, so that profiles of the same program compare line by line
+    vector<pair<string, uint64_t>> sorted(blocks.begin(), blocks.end());
+    sort(sorted.begin(), sorted.end());
+    file << "# label count\n";
+    for (const auto& [label, count] : sorted) file << label << ' ' << count << '\n';
+    if (!edges.empty()) file << "# label target count\n";
+    for (const auto& [labels, count] : edges) file << labels.first << ' ' << labels.second << ' ' << count << '\n';
+    long long written = file.tellp();
+    return file ? written : -1;
+}
+
+namespace {
+
+constexpr uint32_t noBlock = 0xFFFFFFFF;
+
+struct Block {
+    uint32_t start, end;         // Instruction indices
+    SymbolId label = noSymbolId; // A label at start; only the entry block can lack one
+    uint64_t count = 0;
+    uint32_t taken = noBlock;    // Block the closing branch or jump goes to
+    bool branches = false;       // Closes with a conditional branch to taken
+    bool fallsThrough = true;    // Can go on into the next block in source order
+    uint32_t next = noBlock;     // Neighbours in its chain
+    uint32_t previous = noBlock;
+};
+
+// Placing to right after from makes this transfer a fall-through
+struct Edge {
+    uint32_t from, to;
+    uint64_t weight;
+    bool inSourceOrder;
+};
+
+uint32_t findChain(vector<uint32_t>& parent, uint32_t block) {
+    while (parent[block] != block) block = parent[block] = parent[parent[block]];
+    return block;
+}
+
+} // namespace
+
+bool reorderBlocks(Program& program, SymbolTable& symbolTable, vector<TextLabel>& textLabels,
+                   const BlockProfile& profile, string& text) {
+    size_t count = program.size();
+    if (count == 0) return true;
+
+    // Blocks start at the entry and at every label before the end of the
+    // text; blockOf maps their labels, and labels at the end, to blocks.size()
+    stable_sort(textLabels.begin(), textLabels.end(),
+                [](const TextLabel& a, const TextLabel& b) { return a.index < b.index; });
+    vector<Block> blocks{Block{0, 0}};
+    vector<uint32_t> blockOf(symbolTable.size(), noBlock);
+    for (const TextLabel& label : textLabels) {
+        if (label.index >= count) continue;
+        if (label.index != blocks.back().start) blocks.push_back(Block{label.index, 0});
+        if (blocks.back().label == noSymbolId) blocks.back().label = label.symbol;
+        blockOf[label.symbol] = static_cast<uint32_t>(blocks.size() - 1);
+    }
+    for (const TextLabel& label : textLabels) {
+        if (label.index >= count) blockOf[label.symbol] = static_cast<uint32_t>(blocks.size());
+    }
+    if (blocks.size() == 1) return true;
+    for (size_t k = 0; k < blocks.size(); k++) {
+        blocks[k].end = k + 1 < blocks.size() ? blocks[k + 1].start : static_cast<uint32_t>(count);
+    }
+
+    // Moving blocks apart is only safe when every reference to code names the
+    // label of the block it reaches
+    for (size_t i = 0; i < count; i++) {
+        SymbolId symbol = program.symbols[i];
+        Format format = program.desc(i).format;
+        bool literalJump = symbol == noSymbolId && (format == Format::SB || format == Format::UJ);
+        if (literalJump || (symbol != noSymbolId && blockOf[symbol] != noBlock && program.immediates[i] != 0)) {
+            cerr << "Error: Cannot reorder blocks around '" << program.text(i)
+                 << "'; branches and code addresses must name a label without an offset" << endl;
+            return false;
+        }
+    }
+
+    // How each block ends, and how often it ran
+    for (Block& block : blocks) {
+        uint32_t last = block.end - 1;
+        uint8_t id = program.ids[last];
+        uint32_t target = program.symbols[last] == noSymbolId ? noBlock : blockOf[program.symbols[last]];
+        if (target >= blocks.size()) target = noBlock;
+        if (id == idJalr && program.rd[last] == 0) {
+            block.fallsThrough = false;
+        } else if (id == idJal && program.rd[last] == 0) {
+            block.fallsThrough = false;
+            block.taken = target;
+        } else if (program.desc(last).format == Format::SB && target != noBlock) {
+            block.branches = true;
+            block.taken = target;
+        }
+    }
+    for (const TextLabel& label : textLabels) {
+        auto found = profile.blocks.find(string(symbolTable.name(label.symbol)));
+        if (label.index < count && found != profile.blocks.end()) {
+            Block& block = blocks[blockOf[label.symbol]];
+            block.count = max(block.count, found->second);
+        }
+    }
+
+    // Edge counts from the profile, or else the smaller count of the two ends
+    map<pair<uint32_t, uint32_t>, uint64_t> measured;
+    for (const auto& [labels, value] : profile.edges) {
+        SymbolId from = symbolTable.find(labels.first), to = symbolTable.find(labels.second);
+        if (from == noSymbolId || to == noSymbolId || from >= blockOf.size() || to >= blockOf.size() ||
+            blockOf[from] >= blocks.size() || blockOf[to] >= blocks.size()) {
+            continue;
+        }
+        measured[{blockOf[from], blockOf[to]}] += value;
+    }
+    auto weight = [&](uint32_t from, uint32_t to) {
+        auto found = measured.find({from, to});
+        return found != measured.end() ? found->second : min(blocks[from].count, blocks[to].count);
+    };
+    vector<Edge> edges;
+    for (uint32_t k = 0; k < blocks.size(); k++) {
+        if (blocks[k].fallsThrough && k + 1 < blocks.size()) edges.push_back({k, k + 1, weight(k, k + 1), true});
+        uint32_t taken = blocks[k].taken;
+        if (taken == noBlock || taken == k || (blocks[k].fallsThrough && taken == k + 1)) continue;
+        edges.push_back({k, taken, weight(k, taken), taken == k + 1});
+    }
+    sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) {
+        if (a.weight != b.weight) return a.weight > b.weight;
+        if (a.inSourceOrder != b.inSourceOrder) return a.inSourceOrder;
+        return a.from < b.from;
+    });
+
+    // Chain blocks along the heaviest edges. The entry block heads the first
+    // chain; a last block that falls off the end of the text closes the last
+    // one, so those two chains must stay apart.
+    uint32_t last = static_cast<uint32_t>(blocks.size() - 1);
+    bool lastPinned = blocks[last].fallsThrough;
+    vector<uint32_t> chain(blocks.size());
+    iota(chain.begin(), chain.end(), 0);
+    for (const Edge& edge : edges) {
+        if (edge.weight == 0) break;
+        Block& from = blocks[edge.from];
+        Block& to = blocks[edge.to];
+        if (from.next != noBlock || to.previous != noBlock || edge.to == 0 || (lastPinned && edge.from == last)) {
+            continue;
+        }
+        uint32_t a = findChain(chain, edge.from), b = findChain(chain, edge.to);
+        if (a == b || (lastPinned && a == findChain(chain, 0) && b == findChain(chain, last))) continue;
+        from.next = edge.to;
+        to.previous = edge.from;
+        chain[b] = a;
+    }
+
+    // Entry chain first, the hottest of the rest next, source order among equals
+    vector<pair<uint64_t, uint32_t>> heads; // Hottest block count and head of each chain
+    uint32_t closing = noBlock;
+    for (uint32_t k = 0; k < blocks.size(); k++) {
+        if (blocks[k].previous != noBlock) continue;
+        uint64_t heat = 0;
+        for (uint32_t b = k; b != noBlock; b = blocks[b].next) {
+            heat = max(heat, blocks[b].count);
+            if (lastPinned && b == last) closing = k;
+        }
+        heads.emplace_back(heat, k);
+    }
+    sort(heads.begin(), heads.end(), [&](const pair<uint64_t, uint32_t>& a, const pair<uint64_t, uint32_t>& b) {
+        if ((a.second == 0) != (b.second == 0)) return a.second == 0;
+        if ((a.second == closing) != (b.second == closing)) return b.second == closing;
+        if (a.first != b.first) return a.first > b.first;
+        return a.second < b.second;
+    });
+    vector<uint32_t> order;
+    order.reserve(blocks.size());
+    for (const auto& head : heads) {
+        for (uint32_t b = head.second; b != noBlock; b = blocks[b].next) order.push_back(b);
+    }
+
+    // Emit the blocks in their new order, fixing up how each one ends. The
+    // statements go to text in the same order; a changed or added branch or
+    // jump gets one written for it.
+    Program original = program;
+    program.clear();
+    program.reserve(count + blocks.size());
+    text.clear();
+    size_t previous = count; // Entry last copied, whose statement the next one may share
+    auto push = [&](uint8_t id, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t immediate, SymbolId symbol,
+                    Modifier modifier, uint32_t offset, uint16_t length) {
+        program.ids.push_back(id);
+        program.rd.push_back(rd);
+        program.rs1.push_back(rs1);
+        program.rs2.push_back(rs2);
+        program.immediates.push_back(immediate);
+        program.symbols.push_back(symbol);
+        program.modifiers.push_back(modifier);
+        program.sourceOffsets.push_back(offset);
+        program.sourceLengths.push_back(length);
+    };
+    auto pushStatement = [&](uint8_t id, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t immediate, SymbolId symbol,
+                             Modifier modifier, string_view statement) {
+        push(id, rd, rs1, rs2, immediate, symbol, modifier, static_cast<uint32_t>(text.size()),
+             static_cast<uint16_t>(statement.size()));
+        text.append(statement.data(), statement.size());
+        previous = count;
+    };
+    auto append = [&](size_t from) {
+        // Pseudo-instructions expand to several entries of one statement, which is stored once
+        if (previous + 1 == from && original.sourceOffsets[from] == original.sourceOffsets[previous]) {
+            push(original.ids[from], original.rd[from], original.rs1[from], original.rs2[from],
+                 original.immediates[from], original.symbols[from], original.modifiers[from],
+                 program.sourceOffsets.back(), program.sourceLengths.back());
+        } else {
+            pushStatement(original.ids[from], original.rd[from], original.rs1[from], original.rs2[from],
+                          original.immediates[from], original.symbols[from], original.modifiers[from],
+                          original.text(from));
+        }
+        previous = from;
+    };
+    vector<uint32_t> newStart(blocks.size() + 1);
+    size_t inverted = 0, dropped = 0, added = 0;
+    for (size_t p = 0; p < order.size(); p++) {
+        uint32_t k = order[p];
+        const Block& block = blocks[k];
+        uint32_t follower = p + 1 < order.size() ? order[p + 1] : noBlock;
+        uint32_t successor = k + 1 < blocks.size() ? k + 1 : noBlock; // noBlock: the end of the text
+        uint32_t last = block.end - 1;
+        newStart[k] = static_cast<uint32_t>(program.size());
+        for (uint32_t i = block.start; i < last; i++) append(i);
+        if (!block.fallsThrough && block.taken != noBlock && block.taken == follower) {
+            dropped++; // A jal x0 to the block that now follows
+            continue;
+        }
+        if (!block.fallsThrough || successor == follower) {
+            append(last);
+            continue;
+        }
+        SymbolId label = blocks[successor].label;
+        string target(symbolTable.name(label));
+        if (block.branches && block.taken == follower) {
+            uint8_t id = invertedBranch(original.ids[last]);
+            uint8_t rs1 = original.rs1[last], rs2 = original.rs2[last];
+            pushStatement(id, 0, rs1, rs2, 0, label, Modifier::None,
+                          string(instructionTable[id].mnemonic) + " x" + to_string(rs1) + ", x" + to_string(rs2) +
+                              ", " + target);
+            inverted++;
+            continue;
+        }
+        // Jump to the old successor
+        append(last);
+        pushStatement(idJal, 0, 0, 0, 0, label, Modifier::None, "j " + target);
+        added++;
+    }
+    newStart[blocks.size()] = static_cast<uint32_t>(program.size());
+    program.setSource(text);
+
+    for (TextLabel& label : textLabels) label.index = newStart[blockOf[label.symbol]];
+    stable_sort(textLabels.begin(), textLabels.end(),
+                [](const TextLabel& a, const TextLabel& b) { return a.index < b.index; });
+    DEBUG_LOG("Block reordering: " << blocks.size() << " blocks, " << inverted << " branches inverted, " << dropped
+                                   << " jumps dropped, " << added << " added");
+    return true;
+}
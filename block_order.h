@@ -0,0 +1,50 @@
+#ifndef BLOCK_ORDER_H
+#define BLOCK_ORDER_H
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "program.h"
+#include "relaxation.h"
+#include "symbol_table.h"
+
+// Execution counts that guide basic block reordering, by label name. The
+// text format has one entry per line, '#' starting a comment:
+//   label count          the block starting at label ran count times
+//   label target count   control passed count times from the block at label
+//                        to the block at target (a branch or fall-through)
+// Block counts are what --run --profile-out writes; edge counts, where a
+// profile has them, replace the estimate made from the block counts.
+struct BlockProfile {
+    std::unordered_map<std::string, uint64_t> blocks;
+    std::map<std::pair<std::string, std::string>, uint64_t> edges;
+
+    void clear();
+    // Reports problems to cerr
+    bool load(const std::string& filename);
+    // Returns the bytes written or -1
+    long long save(const std::string& filename) const;
+};
+
+// Reorder the basic blocks of a parsed program (before layoutText) so that
+// the hotter successor of each block falls through. A block starts at a text
+// label and runs to the next one; the code before the first label stays
+// first, and a last block that falls off the end of the text stays last.
+// Blocks are chained greedily along their heaviest edges, the entry chain
+// first and the others hottest first. A conditional branch whose target now
+// follows it is inverted to branch to the old fall-through, a jal to the
+// next block is dropped, and a jal x0 is added wherever a block no longer
+// falls through to its old successor. Text labels move with their blocks;
+// layoutText then recomputes every address and offset. The statements are
+// copied to text in their new order, with one written for each changed or
+// added branch or jump, and text becomes the program's source, so it must
+// outlive the program.
+//
+// Fails, reporting to cerr, when code depends on where blocks sit: a branch
+// or jump to a literal offset, or a label operand pointing past a label.
+bool reorderBlocks(Program& program, SymbolTable& symbolTable, std::vector<TextLabel>& textLabels,
+                   const BlockProfile& profile, std::string& text);
+
+#endif
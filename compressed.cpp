@@ -0,0 +1,228 @@
+#include "compressed.h"
+#include "converter.h"
+#include "encoder.h"
+#include "instruction_table.h"
+
+using namespace std;
+
+static constexpr uint8_t idAdd = instructionId("add");
+static constexpr uint8_t idSub = instructionId("sub");
+static constexpr uint8_t idXor = instructionId("xor");
+static constexpr uint8_t idOr = instructionId("or");
+static constexpr uint8_t idAnd = instructionId("and");
+static constexpr uint8_t idAddi = instructionId("addi");
+static constexpr uint8_t idAndi = instructionId("andi");
+static constexpr uint8_t idLw = instructionId("lw");
+static constexpr uint8_t idSw = instructionId("sw");
+static constexpr uint8_t idJalr = instructionId("jalr");
+static constexpr uint8_t idBeq = instructionId("beq");
+static constexpr uint8_t idBne = instructionId("bne");
+static constexpr uint8_t idLui = instructionId("lui");
+static constexpr uint8_t idJal = instructionId("jal");
+
+// Bits hi..lo of value, shifted down to bit 0
+static uint32_t bits(int32_t value, int hi, int lo) {
+    return (static_cast<uint32_t>(value) >> lo) & ((1u << (hi - lo + 1)) - 1);
+}
+
+static bool fitsSigned(int32_t value, int width) {
+    return value >= -(1 << (width - 1)) && value < (1 << (width - 1));
+}
+
+// x8..x15, the registers the 3-bit register fields can name
+static bool isCompactRegister(uint8_t reg) { return reg >= 8 && reg <= 15; }
+
+// Immediate layouts shared by several forms
+static uint16_t lwImmediate(int32_t imm) {  // uimm[5:3] at 12:10, uimm[2|6] at 6:5
+    return static_cast<uint16_t>((bits(imm, 5, 3) << 10) | (bits(imm, 2, 2) << 6) | (bits(imm, 6, 6) << 5));
+}
+
+static uint16_t jumpImmediate(int32_t imm) { // offset[11|4|9:8|10|6|7|3:1|5] at 12:2
+    return static_cast<uint16_t>((bits(imm, 11, 11) << 12) | (bits(imm, 4, 4) << 11) | (bits(imm, 9, 8) << 9) |
+                                 (bits(imm, 10, 10) << 8) | (bits(imm, 6, 6) << 7) | (bits(imm, 7, 7) << 6) |
+                                 (bits(imm, 3, 1) << 3) | (bits(imm, 5, 5) << 2));
+}
+
+static uint16_t branchImmediate(int32_t imm) { // offset[8|4:3] at 12:10, offset[7:6|2:1|5] at 6:2
+    return static_cast<uint16_t>((bits(imm, 8, 8) << 12) | (bits(imm, 4, 3) << 10) | (bits(imm, 7, 6) << 5) |
+                                 (bits(imm, 2, 1) << 3) | (bits(imm, 5, 5) << 2));
+}
+
+// CI layout: imm[5] at 12, rd at 11:7, imm[4:0] at 6:2
+static uint16_t formatCI(uint32_t func3, uint8_t rd, int32_t imm, uint32_t quadrant) {
+    return static_cast<uint16_t>((func3 << 13) | (bits(imm, 5, 5) << 12) | (rd << 7) | (bits(imm, 4, 0) << 2) | quadrant);
+}
+
+// CR layout: func4 at 15:12, rd/rs1 at 11:7, rs2 at 6:2
+static uint16_t formatCR(uint32_t func4, uint8_t rd, uint8_t rs2) {
+    return static_cast<uint16_t>((func4 << 12) | (rd << 7) | (rs2 << 2) | 0x2);
+}
+
+// CA layout for c.sub/c.xor/c.or/c.and
+static uint16_t formatCA(uint32_t func2, uint8_t rd, uint8_t rs2) {
+    return static_cast<uint16_t>((0x23 << 10) | ((rd - 8) << 7) | (func2 << 5) | ((rs2 - 8) << 2) | 0x1);
+}
+
+uint16_t compressInstruction(uint8_t id, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t imm) {
+    if (id == idAddi) {
+        if (rd == 0 && rs1 == 0 && imm == 0) return 0x0001; // c.nop
+        if (rd != 0 && rd == rs1 && imm != 0 && fitsSigned(imm, 6)) return formatCI(0, rd, imm, 1);
+        if (rd != 0 && rs1 == 0 && fitsSigned(imm, 6)) return formatCI(2, rd, imm, 1); // c.li
+        if (rd == 2 && rs1 == 2 && imm != 0 && imm % 16 == 0 && fitsSigned(imm, 10)) { // c.addi16sp
+            return static_cast<uint16_t>((3 << 13) | (bits(imm, 9, 9) << 12) | (2 << 7) | (bits(imm, 4, 4) << 6) |
+                                         (bits(imm, 6, 6) << 5) | (bits(imm, 8, 7) << 3) | (bits(imm, 5, 5) << 2) | 1);
+        }
+        if (isCompactRegister(rd) && rs1 == 2 && imm > 0 && imm % 4 == 0 && imm < 1024) { // c.addi4spn
+            return static_cast<uint16_t>((bits(imm, 5, 4) << 11) | (bits(imm, 9, 6) << 7) | (bits(imm, 2, 2) << 6) |
+                                         (bits(imm, 3, 3) << 5) | ((rd - 8) << 2));
+        }
+        if (rd != 0 && rs1 != 0 && imm == 0) return formatCR(0x8, rd, rs1); // c.mv
+        return 0;
+    }
+    if (id == idAdd) {
+        if (rd == 0) return 0;
+        if (rs1 == 0 && rs2 != 0) return formatCR(0x8, rd, rs2);          // c.mv
+        if (rs2 == 0 && rs1 != 0) return formatCR(0x8, rd, rs1);
+        if (rd == rs1 && rs2 != 0) return formatCR(0x9, rd, rs2);         // c.add
+        if (rd == rs2 && rs1 != 0) return formatCR(0x9, rd, rs1);
+        return 0;
+    }
+    if (id == idSub || id == idXor || id == idOr || id == idAnd) {
+        uint32_t func2 = id == idSub ? 0 : id == idXor ? 1 : id == idOr ? 2 : 3;
+        if (!isCompactRegister(rd)) return 0;
+        if (rd == rs1 && isCompactRegister(rs2)) return formatCA(func2, rd, rs2);
+        if (id != idSub && rd == rs2 && isCompactRegister(rs1)) return formatCA(func2, rd, rs1); // Commutative
+        return 0;
+    }
+    if (id == idAndi) {
+        if (!isCompactRegister(rd) || rd != rs1 || !fitsSigned(imm, 6)) return 0;
+        return static_cast<uint16_t>((4 << 13) | (bits(imm, 5, 5) << 12) | (2 << 10) | ((rd - 8) << 7) |
+                                     (bits(imm, 4, 0) << 2) | 1);
+    }
+    if (id == idLui) {
+        int32_t value = signExtend(static_cast<uint32_t>(imm) & 0xFFFFF, 20);
+        if (rd == 0 || rd == 2 || value == 0 || !fitsSigned(value, 6)) return 0;
+        return formatCI(3, rd, value, 1);
+    }
+    if (id == idLw || id == idSw) {
+        uint8_t reg = id == idLw ? rd : rs2;
+        if (imm < 0 || imm % 4 != 0) return 0;
+        if (isCompactRegister(reg) && isCompactRegister(rs1) && imm < 128) {
+            return static_cast<uint16_t>(((id == idLw ? 2 : 6) << 13) | lwImmediate(imm) | ((rs1 - 8) << 7) | ((reg - 8) << 2));
+        }
+        if (rs1 != 2 || imm >= 256) return 0;
+        if (id == idLw) { // c.lwsp: uimm[5] at 12, uimm[4:2|7:6] at 6:2
+            if (rd == 0) return 0;
+            return static_cast<uint16_t>((2 << 13) | (bits(imm, 5, 5) << 12) | (rd << 7) | (bits(imm, 4, 2) << 4) |
+                                         (bits(imm, 7, 6) << 2) | 2);
+        }
+        // c.swsp: uimm[5:2|7:6] at 12:7
+        return static_cast<uint16_t>((6 << 13) | (bits(imm, 5, 2) << 9) | (bits(imm, 7, 6) << 7) | (rs2 << 2) | 2);
+    }
+    if (id == idJalr) {
+        if (imm != 0 || rs1 == 0 || rd > 1) return 0;
+        return formatCR(rd == 0 ? 0x8 : 0x9, rs1, 0); // c.jr / c.jalr
+    }
+    if (id == idJal) {
+        if (rd > 1 || imm % 2 != 0 || !fitsSigned(imm, 12)) return 0;
+        return static_cast<uint16_t>(((rd == 0 ? 5 : 1) << 13) | jumpImmediate(imm) | 1); // c.j / c.jal
+    }
+    if (id == idBeq || id == idBne) {
+        if (rs2 != 0 || !isCompactRegister(rs1) || imm % 2 != 0 || !fitsSigned(imm, 9)) return 0;
+        return static_cast<uint16_t>(((id == idBeq ? 6 : 7) << 13) | branchImmediate(imm) | ((rs1 - 8) << 7) | 1);
+    }
+    return 0;
+}
+
+// Field decoders for the expansion
+static uint8_t compactRegister(uint16_t half, int lo) { return static_cast<uint8_t>(((half >> lo) & 0x7) + 8); }
+static int32_t immediateCI(uint16_t half) { return signExtend((bits(half, 12, 12) << 5) | bits(half, 6, 2), 6); }
+
+static uint32_t encodeRow(uint8_t id, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t imm) {
+    return encodeInstruction(instructionTable[id], rd, rs1, rs2, imm);
+}
+
+uint32_t expandCompressed(uint16_t half) {
+    uint32_t quadrant = half & 0x3;
+    uint32_t func3 = half >> 13;
+    uint8_t rd = static_cast<uint8_t>(bits(half, 11, 7));
+    uint8_t rs2 = static_cast<uint8_t>(bits(half, 6, 2));
+
+    if (quadrant == 0) {
+        uint32_t uimm = (bits(half, 5, 5) << 6) | (bits(half, 12, 10) << 3) | (bits(half, 6, 6) << 2);
+        switch (func3) {
+            case 0: { // c.addi4spn
+                int32_t imm = static_cast<int32_t>((bits(half, 12, 11) << 4) | (bits(half, 10, 7) << 6) |
+                                                   (bits(half, 6, 6) << 2) | (bits(half, 5, 5) << 3));
+                if (imm == 0) return 0; // Includes the all-zero illegal instruction
+                return encodeRow(idAddi, compactRegister(half, 2), 2, 0, imm);
+            }
+            case 2: return encodeRow(idLw, compactRegister(half, 2), compactRegister(half, 7), 0, static_cast<int32_t>(uimm));
+            case 6: return encodeRow(idSw, 0, compactRegister(half, 7), compactRegister(half, 2), static_cast<int32_t>(uimm));
+            default: return 0;
+        }
+    }
+
+    if (quadrant == 1) {
+        switch (func3) {
+            case 0: return encodeRow(idAddi, rd, rd, 0, immediateCI(half)); // c.nop / c.addi
+            case 1:
+            case 5: {
+                int32_t offset = signExtend((bits(half, 12, 12) << 11) | (bits(half, 11, 11) << 4) |
+                                            (bits(half, 10, 9) << 8) | (bits(half, 8, 8) << 10) |
+                                            (bits(half, 7, 7) << 6) | (bits(half, 6, 6) << 7) |
+                                            (bits(half, 5, 3) << 1) | (bits(half, 2, 2) << 5), 12);
+                return encodeRow(idJal, func3 == 1 ? 1 : 0, 0, 0, offset); // c.jal / c.j
+            }
+            case 2: return encodeRow(idAddi, rd, 0, 0, immediateCI(half)); // c.li
+            case 3: {
+                if (rd == 2) { // c.addi16sp
+                    int32_t imm = signExtend((bits(half, 12, 12) << 9) | (bits(half, 6, 6) << 4) |
+                                             (bits(half, 5, 5) << 6) | (bits(half, 4, 3) << 7) |
+                                             (bits(half, 2, 2) << 5), 10);
+                    return imm == 0 ? 0 : encodeRow(idAddi, 2, 2, 0, imm);
+                }
+                int32_t imm = immediateCI(half); // c.lui
+                return imm == 0 || rd == 0 ? 0 : encodeRow(idLui, rd, 0, 0, imm);
+            }
+            case 4: {
+                uint8_t reg = compactRegister(half, 7);
+                uint32_t func2 = bits(half, 11, 10);
+                if (func2 == 2) return encodeRow(idAndi, reg, reg, 0, immediateCI(half));
+                if (func2 != 3 || bits(half, 12, 12) != 0) return 0; // Shifts and RV64 forms
+                static constexpr uint8_t arithmetic[] = {idSub, idXor, idOr, idAnd};
+                return encodeRow(arithmetic[bits(half, 6, 5)], reg, reg, compactRegister(half, 2), 0);
+            }
+            case 6:
+            case 7: {
+                int32_t offset = signExtend((bits(half, 12, 12) << 8) | (bits(half, 11, 10) << 3) |
+                                            (bits(half, 6, 5) << 6) | (bits(half, 4, 3) << 1) |
+                                            (bits(half, 2, 2) << 5), 9);
+                return encodeRow(func3 == 6 ? idBeq : idBne, 0, compactRegister(half, 7), 0, offset);
+            }
+        }
+        return 0;
+    }
+
+    if (quadrant == 2) {
+        switch (func3) {
+            case 2: { // c.lwsp
+                if (rd == 0) return 0;
+                int32_t imm = static_cast<int32_t>((bits(half, 12, 12) << 5) | (bits(half, 6, 4) << 2) | (bits(half, 3, 2) << 6));
+                return encodeRow(idLw, rd, 2, 0, imm);
+            }
+            case 4:
+                if (bits(half, 12, 12) == 0) {
+                    if (rs2 == 0) return rd == 0 ? 0 : encodeRow(idJalr, 0, rd, 0, 0); // c.jr
+                    return rd == 0 ? 0 : encodeRow(idAdd, rd, 0, rs2, 0);             // c.mv
+                }
+                if (rs2 == 0) return rd == 0 ? 0 : encodeRow(idJalr, 1, rd, 0, 0);     // c.jalr (c.ebreak unsupported)
+                return rd == 0 ? 0 : encodeRow(idAdd, rd, rd, rs2, 0);                  // c.add
+            case 6: { // c.swsp
+                int32_t imm = static_cast<int32_t>((bits(half, 12, 9) << 2) | (bits(half, 8, 7) << 6));
+                return encodeRow(idSw, 0, 2, rs2, imm);
+            }
+        }
+    }
+    return 0;
+}
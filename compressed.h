@@ -0,0 +1,20 @@
+#ifndef COMPRESSED_H
+#define COMPRESSED_H
+#include <cstdint>
+
+// RV32C support for the base instructions in instructionTable.
+//
+// Supported forms: c.nop c.addi c.li c.addi16sp c.addi4spn c.lui c.andi
+// c.mv c.add c.sub c.xor c.or c.and c.lw c.sw c.lwsp c.swsp c.j c.jal c.jr
+// c.jalr c.beqz c.bnez. Shifts and the RV64-only forms have no base
+// instruction here to map to.
+
+// 16-bit encoding of an instruction (by instructionTable row), or 0 if its
+// operands have no compressed form. Branch/jump immediates are byte offsets.
+uint16_t compressInstruction(uint8_t id, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t immediate);
+
+// The equivalent 32-bit instruction, or 0 if the halfword is not one of the
+// supported forms
+uint32_t expandCompressed(uint16_t half);
+
+#endif
@@ -3,14 +3,14 @@
 #include <cstdint>
 #include <string>
 #include <vector>
-#include "symbol_table.h"
-#include "parser.h"
+#include "program.h"
 using namespace std;
 
-// Declare instructionMap without defining it
-extern map<string, pair<string, string>> instructionMap;
-uint32_t convertToMachineCode( Instruction& instruction, const SymbolTable& symbolTable);
-string registerToBinary(const string& reg);
-string immediateToBinary(int imm, int bits);
+// Encode one instruction from its table row and fields (32-bit form)
+uint32_t encodeInstruction(const InstructionDesc& desc, uint32_t rd, uint32_t rs1, uint32_t rs2, int32_t immediate);
+// Encode one program instruction, using its RV32C form if layout chose one
+uint32_t convertToMachineCode(const Program& program, size_t index);
+// Encode every instruction of program into code, split across up to jobs threads (0 = all cores)
+void encodeProgram(const Program& program, vector<uint32_t>& code, unsigned jobs);
 
 #endif
\ No newline at end of file
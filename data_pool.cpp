@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include "data_pool.h"
+#include "debug_log.h"
+
+using namespace std;
+
+namespace {
+
+// A piece of the data image that moves as a whole: a read-only object, from
+// a label or the start of the section, or a stretch of writable data
+struct DataObject {
+    uint32_t start, end;     // Offsets in the original image
+    bool readOnly;
+    bool labelled;
+    uint32_t alignment = 1;  // The new offset must equal start modulo this
+    uint32_t target = 0;     // Object holding its bytes afterwards, itself if kept
+    uint32_t offset = 0;     // Where in target
+    uint32_t newStart = 0;
+
+    uint32_t size() const { return end - start; }
+};
+
+// Split the image into objects, in address order. labels holds the offsets
+// of the data labels, sorted.
+vector<DataObject> splitObjects(const DataSegment& data, const vector<uint32_t>& labels) {
+    vector<DataObject> objects;
+    size_t label = 0;
+    auto add = [&](uint32_t start, uint32_t end, bool readOnly) {
+        while (label < labels.size() && labels[label] < start) label++;
+        bool labelled = label < labels.size() && labels[label] == start;
+        objects.push_back({start, end, readOnly, labelled});
+        objects.back().target = static_cast<uint32_t>(objects.size() - 1);
+    };
+
+    uint32_t position = 0;
+    for (const DataSegment::Range& range : data.readOnlyRanges()) {
+        if (range.start == range.end) continue;
+        if (position < range.start) add(position, range.start, false);
+        position = range.start;
+        // Labels inside the range start objects
+        auto next = upper_bound(labels.begin(), labels.end(), position);
+        for (; next != labels.end() && *next < range.end; ++next) {
+            add(position, *next, true);
+            position = *next;
+        }
+        add(position, range.end, true);
+        position = range.end;
+    }
+    uint32_t size = static_cast<uint32_t>(data.size());
+    if (position < size) add(position, size, false);
+    return objects;
+}
+
+// Alignment each object must keep. Writable data only moves by multiples of
+// any alignment it may hold; read-only objects keep what their marks need.
+void findAlignments(const DataSegment& data, vector<DataObject>& objects) {
+    const vector<DataSegment::AlignmentMark>& marks = data.alignmentMarks();
+    uint32_t writableAlignment = max<uint32_t>(data.alignment(), 8);
+    size_t first = 0;
+    for (DataObject& object : objects) {
+        if (!object.readOnly) {
+            object.alignment = writableAlignment;
+            continue;
+        }
+        auto before = [&](const DataSegment::AlignmentMark& mark) {
+            return mark.start == mark.end ? mark.start < object.start : mark.end <= object.start;
+        };
+        while (first < marks.size() && before(marks[first])) first++;
+        for (size_t m = first; m < marks.size() && marks[m].start < object.end; m++) {
+            object.alignment = max(object.alignment, marks[m].alignment);
+        }
+    }
+}
+
+// Merge every labelled read-only object whose bytes end another one into
+// it. Sorted by their bytes read backwards, largest first, an object that
+// ends another comes right after it or after another such object.
+bool mergeObjects(const DataSegment& data, vector<DataObject>& objects) {
+    const uint8_t* image = data.data();
+    vector<uint32_t> order;
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        if (objects[i].readOnly && objects[i].labelled) order.push_back(i);
+    }
+    sort(order.begin(), order.end(), [&](uint32_t left, uint32_t right) {
+        const DataObject& a = objects[left];
+        const DataObject& b = objects[right];
+        uint32_t common = min(a.size(), b.size());
+        for (uint32_t i = 1; i <= common; i++) {
+            uint8_t x = image[a.end - i], y = image[b.end - i];
+            if (x != y) return x > y;
+        }
+        if (a.size() != b.size()) return a.size() > b.size();
+        if (a.alignment != b.alignment) return a.alignment > b.alignment; // The strictest one is kept
+        return a.start < b.start;
+    });
+
+    bool merged = false;
+    for (size_t k = 1; k < order.size(); k++) {
+        DataObject& object = objects[order[k]];
+        const DataObject& previous = objects[order[k - 1]];
+        if (object.size() > previous.size() ||
+            memcmp(image + object.start, image + previous.end - object.size(), object.size()) != 0) {
+            continue;
+        }
+        const DataObject& target = objects[previous.target];
+        uint32_t offset = previous.offset + previous.size() - object.size();
+        // Kept objects move by multiples of their alignment, so this holds afterwards
+        if (object.alignment > target.alignment || (target.start + offset - object.start) % object.alignment != 0) {
+            continue;
+        }
+        object.target = previous.target;
+        object.offset = offset;
+        merged = true;
+    }
+    return merged;
+}
+
+} // namespace
+
+size_t poolReadOnlyData(DataSegment& data, SymbolTable& symbolTable, const vector<TextLabel>& textLabels) {
+    if (data.readOnlyRanges().empty()) return 0;
+
+    // Data labels by offset
+    uint32_t size = static_cast<uint32_t>(data.size());
+    vector<bool> isText(symbolTable.size(), false);
+    for (const TextLabel& label : textLabels) isText[label.symbol] = true;
+    vector<pair<uint32_t, SymbolId>> labels;
+    for (SymbolId id = 0; id < symbolTable.size(); id++) {
+        uint32_t address = symbolTable.address(id);
+        if (!symbolTable.isLabel(id) || isText[id] || address < DataSegment::baseAddress ||
+            address - DataSegment::baseAddress > size) {
+            continue;
+        }
+        labels.emplace_back(address - DataSegment::baseAddress, id);
+    }
+    sort(labels.begin(), labels.end());
+    vector<uint32_t> offsets;
+    offsets.reserve(labels.size());
+    for (const auto& label : labels) offsets.push_back(label.first);
+
+    vector<DataObject> objects = splitObjects(data, offsets);
+    findAlignments(data, objects);
+    if (!mergeObjects(data, objects)) return 0;
+
+    // Close up the kept objects in their original order
+    uint32_t newSize = 0;
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        DataObject& object = objects[i];
+        if (object.target != i) continue;
+        object.newStart = newSize + ((object.start - newSize) & (object.alignment - 1));
+        newSize = object.newStart + object.size();
+    }
+    vector<uint8_t> image(newSize, 0);
+    for (uint32_t i = 0; i < objects.size(); i++) {
+        DataObject& object = objects[i];
+        if (object.target != i) {
+            object.newStart = objects[object.target].newStart + object.offset;
+            continue;
+        }
+        memcpy(image.data() + object.newStart, data.data() + object.start, object.size());
+    }
+
+    size_t object = 0;
+    for (const auto& [offset, id] : labels) {
+        while (object < objects.size() && objects[object].end <= offset) object++;
+        uint32_t newOffset = object < objects.size() ? objects[object].newStart + (offset - objects[object].start)
+                                                     : newSize;
+        symbolTable.setAddress(id, DataSegment::baseAddress + newOffset);
+        DEBUG_LOG("Pooled data label '" << symbolTable.name(id) << "' at offset 0x" << hex << newOffset << dec);
+    }
+    data.replace(move(image));
+    return size - newSize;
+}
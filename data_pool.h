@@ -0,0 +1,24 @@
+#ifndef DATA_POOL_H
+#define DATA_POOL_H
+#include <cstddef>
+#include <vector>
+#include "data_segment.h"
+#include "relaxation.h"
+#include "symbol_table.h"
+
+// Shrink the read-only data (.section .rodata) of a parsed program. Every
+// labelled object in it, from its label to the next label or the end of the
+// section, whose bytes equal another object's or end another object's (a
+// string that is a suffix of a longer one, say) is dropped and its labels
+// point into the other object instead. The remaining data closes up, each
+// object keeping the alignment its values and .align directives gave it,
+// and every data label is moved to match.
+//
+// Code must reach read-only data only through the label of the object it
+// reads and offsets within that object. Writable data is never merged. Run
+// this before layoutText, which turns label operands into addresses;
+// textLabels tells the text labels apart from the data labels. Returns the
+// number of bytes saved.
+size_t poolReadOnlyData(DataSegment& data, SymbolTable& symbolTable, const std::vector<TextLabel>& textLabels);
+
+#endif
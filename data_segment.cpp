@@ -0,0 +1,71 @@
+#include <utility>
+#include "data_segment.h"
+
+using namespace std;
+
+// Record that the value about to be written at the current offset is aligned
+// to its size, merging runs of same-sized values
+void DataSegment::markAlignment(uint32_t alignment) {
+    uint32_t offset = static_cast<uint32_t>(bytes.size());
+    if (offset % alignment != 0) return; // Not aligned in the first place, so nothing to keep
+    if (!alignmentMarks_.empty()) {
+        AlignmentMark& last = alignmentMarks_.back();
+        if (last.end == offset && last.end != last.start && last.alignment == alignment) {
+            last.end = offset + alignment;
+            return;
+        }
+    }
+    alignmentMarks_.push_back({offset, offset + alignment, alignment});
+}
+
+void DataSegment::writeHalf(uint16_t value) {
+    if (readOnly) markAlignment(2);
+    bytes.push_back(value & 0xFF);
+    bytes.push_back(value >> 8);
+}
+
+void DataSegment::writeWord(uint32_t value) {
+    if (readOnly) markAlignment(4);
+    for (int shift = 0; shift < 32; shift += 8) bytes.push_back((value >> shift) & 0xFF);
+}
+
+void DataSegment::writeDword(uint64_t value) {
+    if (readOnly) markAlignment(8);
+    for (int shift = 0; shift < 64; shift += 8) bytes.push_back((value >> shift) & 0xFF);
+}
+
+void DataSegment::writeString(string_view text) {
+    bytes.insert(bytes.end(), text.begin(), text.end());
+    bytes.push_back(0); // Null terminator
+}
+
+void DataSegment::align(uint32_t alignment) {
+    if (alignment > strictestAlignment) strictestAlignment = alignment;
+    size_t mask = alignment - 1;
+    bytes.resize((bytes.size() + mask) & ~mask, 0);
+    if (readOnly) {
+        uint32_t offset = static_cast<uint32_t>(bytes.size());
+        alignmentMarks_.push_back({offset, offset, alignment});
+    }
+}
+
+void DataSegment::setReadOnly(bool value) {
+    if (value == readOnly) return;
+    readOnly = value;
+    uint32_t offset = static_cast<uint32_t>(bytes.size());
+    if (readOnly) readOnlyRanges_.push_back({offset, offset});
+    else readOnlyRanges_.back().end = offset;
+}
+
+vector<DataSegment::Range> DataSegment::readOnlyRanges() const {
+    vector<Range> ranges = readOnlyRanges_;
+    if (readOnly) ranges.back().end = static_cast<uint32_t>(bytes.size());
+    return ranges;
+}
+
+void DataSegment::replace(vector<uint8_t> image) {
+    bytes = move(image);
+    readOnly = false;
+    readOnlyRanges_.clear();
+    alignmentMarks_.clear();
+}
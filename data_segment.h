@@ -0,0 +1,73 @@
+#ifndef DATA_SEGMENT_H
+#define DATA_SEGMENT_H
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Contiguous image of the data segment. Values are appended little-endian at
+// the current address, starting from baseAddress. Read-only data (.rodata)
+// shares the image; its offsets are recorded, with the alignment its values
+// and .align directives need, so that poolReadOnlyData can merge and move it.
+class DataSegment {
+public:
+    struct Range {
+        uint32_t start, end; // Offsets from baseAddress
+    };
+    // Offsets in [start, end) that were aligned to alignment: a run of
+    // naturally aligned values, or just start for an .align (start == end)
+    struct AlignmentMark {
+        uint32_t start, end;
+        uint32_t alignment;
+    };
+
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t strictestAlignment = 1;
+    bool readOnly = false;
+    std::vector<Range> readOnlyRanges_;
+    std::vector<AlignmentMark> alignmentMarks_;
+
+    void markAlignment(uint32_t alignment);
+
+public:
+    static constexpr uint32_t baseAddress = 0x10000000;
+
+    void clear() {
+        bytes.clear();
+        strictestAlignment = 1;
+        readOnly = false;
+        readOnlyRanges_.clear();
+        alignmentMarks_.clear();
+    }
+    void reserve(size_t size) { bytes.reserve(size); }
+
+    uint32_t address() const { return baseAddress + static_cast<uint32_t>(bytes.size()); }
+    size_t size() const { return bytes.size(); }
+    const uint8_t* data() const { return bytes.data(); }
+
+    void writeByte(uint8_t value) { bytes.push_back(value); }
+    void writeHalf(uint16_t value);
+    void writeWord(uint32_t value);
+    void writeDword(uint64_t value);
+    void writeBytes(const uint8_t* values, size_t count) { bytes.insert(bytes.end(), values, values + count); }
+    void writeString(std::string_view text); // Appends text plus a null terminator
+    // Append count zero bytes, for a label pass that needs addresses only
+    void skip(size_t count) { bytes.resize(bytes.size() + count, 0); }
+
+    // Pad with zero bytes up to the next multiple of alignment (a power of two)
+    void align(uint32_t alignment);
+    // Largest alignment requested so far; the segment must start on such a boundary
+    uint32_t alignment() const { return strictestAlignment; }
+
+    // Values written from now on are read-only data or not
+    void setReadOnly(bool value);
+    // Offset ranges of the read-only data, in address order
+    std::vector<Range> readOnlyRanges() const;
+    // Alignments needed within the read-only data, in address order
+    const std::vector<AlignmentMark>& alignmentMarks() const { return alignmentMarks_; }
+    // Replace the image with a rearranged one of the same alignment; the
+    // read-only bookkeeping no longer applies and is dropped
+    void replace(std::vector<uint8_t> image);
+};
+
+#endif
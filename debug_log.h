@@ -0,0 +1,14 @@
+#ifndef DEBUG_LOG_H
+#define DEBUG_LOG_H
+
+// Debug tracing for the assembler internals. Compiled out entirely unless the
+// build defines ASM_DEBUG_LOG (e.g. -DASM_DEBUG_LOG), so release builds pay
+// nothing for the log statements or their arguments.
+#ifdef ASM_DEBUG_LOG
+#include <iostream>
+#define DEBUG_LOG(message) (std::cerr << "[DEBUG] " << message << '\n')
+#else
+#define DEBUG_LOG(message) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+#include "disassembler.h"
+#include <charconv>
+#include <cstdio>
+#include "compressed.h"
+#include "encoder.h"
+
+using namespace std;
+
+bool decodeInstruction(uint32_t word, DecodedInstruction& decoded) {
+    const InstructionDesc* desc = findInstructionByEncoding(word);
+    if (desc == nullptr) return false;
+    decoded = DecodedInstruction();
+    decoded.desc = desc;
+    switch (desc->format) {
+        case Format::R:
+            decoded.rd = static_cast<uint8_t>(decodeRd(word));
+            decoded.rs1 = static_cast<uint8_t>(decodeRs1(word));
+            decoded.rs2 = static_cast<uint8_t>(decodeRs2(word));
+            break;
+        case Format::I:
+            decoded.rd = static_cast<uint8_t>(decodeRd(word));
+            decoded.rs1 = static_cast<uint8_t>(decodeRs1(word));
+            decoded.imm = decodeImmI(word);
+            break;
+        case Format::S:
+            decoded.rs1 = static_cast<uint8_t>(decodeRs1(word));
+            decoded.rs2 = static_cast<uint8_t>(decodeRs2(word));
+            decoded.imm = decodeImmS(word);
+            break;
+        case Format::SB:
+            decoded.rs1 = static_cast<uint8_t>(decodeRs1(word));
+            decoded.rs2 = static_cast<uint8_t>(decodeRs2(word));
+            decoded.imm = decodeImmSB(word);
+            break;
+        case Format::U:
+            decoded.rd = static_cast<uint8_t>(decodeRd(word));
+            decoded.imm = decodeImmU(word);
+            break;
+        case Format::UJ:
+            decoded.rd = static_cast<uint8_t>(decodeRd(word));
+            decoded.imm = decodeImmUJ(word);
+            break;
+    }
+    return true;
+}
+
+static void appendRegister(string& out, uint8_t reg) {
+    out += 'x';
+    char buffer[4];
+    out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), reg).ptr);
+}
+
+static void appendInteger(string& out, int32_t value) {
+    char buffer[12];
+    out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+}
+
+// Operand order follows OperandShape, the same layout the parser reads
+void appendDisassembly(const DecodedInstruction& decoded, string& out) {
+    const InstructionDesc& desc = *decoded.desc;
+    out += desc.mnemonic;
+    out += ' ';
+    switch (desc.shape) {
+        case OperandShape::RegRegReg:
+            appendRegister(out, decoded.rd);
+            out += ", ";
+            appendRegister(out, decoded.rs1);
+            out += ", ";
+            appendRegister(out, decoded.rs2);
+            break;
+        case OperandShape::RegRegImm:
+            appendRegister(out, decoded.rd);
+            out += ", ";
+            appendRegister(out, decoded.rs1);
+            out += ", ";
+            appendInteger(out, decoded.imm);
+            break;
+        case OperandShape::RegMem:
+        case OperandShape::StoreMem:
+            appendRegister(out, desc.shape == OperandShape::RegMem ? decoded.rd : decoded.rs2);
+            out += ", ";
+            appendInteger(out, decoded.imm);
+            out += '(';
+            appendRegister(out, decoded.rs1);
+            out += ')';
+            break;
+        case OperandShape::RegRegLabel:
+            appendRegister(out, decoded.rs1);
+            out += ", ";
+            appendRegister(out, decoded.rs2);
+            out += ", ";
+            appendInteger(out, decoded.imm);
+            break;
+        case OperandShape::RegImm: {
+            // Upper immediates read best as the raw 20-bit field in hex
+            appendRegister(out, decoded.rd);
+            out += ", 0x";
+            char buffer[8];
+            out.append(buffer, to_chars(buffer, buffer + sizeof(buffer), static_cast<uint32_t>(decoded.imm) & 0xFFFFF, 16).ptr);
+            break;
+        }
+        case OperandShape::RegLabel:
+            appendRegister(out, decoded.rd);
+            out += ", ";
+            appendInteger(out, decoded.imm);
+            break;
+    }
+}
+
+string disassemble(uint32_t word) {
+    string text;
+    DecodedInstruction decoded;
+    bool compressed = isCompressedWord(word);
+    if (compressed) {
+        // Shown as the 32-bit instruction it expands to, prefixed with "c."
+        uint32_t expanded = expandCompressed(static_cast<uint16_t>(word));
+        if (expanded != 0 && decodeInstruction(expanded, decoded)) {
+            text = "c.";
+            appendDisassembly(decoded, text);
+            return text;
+        }
+    } else if (decodeInstruction(word, decoded)) {
+        appendDisassembly(decoded, text);
+        return text;
+    }
+    char buffer[9];
+    snprintf(buffer, sizeof(buffer), compressed ? "%04x" : "%08x", word);
+    text = compressed ? ".half 0x" : ".word 0x";
+    text += buffer;
+    return text;
+}
@@ -0,0 +1,31 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+#include <cstdint>
+#include <string>
+#include "instruction_table.h"
+
+// An encoded word split back into the fields the parser produces. Fields the
+// format does not use are 0, matching Program; SB/UJ immediates are byte
+// offsets and the U immediate is the sign-extended upper 20 bits.
+struct DecodedInstruction {
+    const InstructionDesc* desc = nullptr;
+    uint8_t rd = 0;
+    uint8_t rs1 = 0;
+    uint8_t rs2 = 0;
+    int32_t imm = 0;
+};
+
+// Decode a word using the shared instruction table; false if it is not a
+// supported instruction
+bool decodeInstruction(uint32_t word, DecodedInstruction& decoded);
+
+// Append the instruction in source syntax, e.g. "lw x5, -4(x2)". Branch and
+// jump targets are written as numeric offsets, which the parser accepts.
+void appendDisassembly(const DecodedInstruction& decoded, std::string& out);
+
+// Disassemble a single word. RV32C words read as "c." plus the instruction
+// they expand to (e.g. "c.addi x8, x8, 1"); unsupported words become
+// ".word 0x..." or ".half 0x..."
+std::string disassemble(uint32_t word);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+#include <cstdint>
+
+// Per-format RISC-V encoders. Every field is passed as a plain integer and
+// packed into the 32-bit instruction word with shifts and masks, so encoding
+// an instruction never touches the heap. The decode helpers at the end are
+// the exact inverses.
+
+// R-format: func7 | rs2 | rs1 | func3 | rd | opcode
+inline uint32_t encodeR(uint32_t opcode, uint32_t func3, uint32_t func7,
+                        uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return ((func7 & 0x7F) << 25) | ((rs2 & 0x1F) << 20) | ((rs1 & 0x1F) << 15) |
+           ((func3 & 0x7) << 12) | ((rd & 0x1F) << 7) | (opcode & 0x7F);
+}
+
+// I-format: imm[11:0] | rs1 | func3 | rd | opcode
+inline uint32_t encodeI(uint32_t opcode, uint32_t func3, uint32_t rd, uint32_t rs1, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFF) << 20) | ((rs1 & 0x1F) << 15) |
+           ((func3 & 0x7) << 12) | ((rd & 0x1F) << 7) | (opcode & 0x7F);
+}
+
+// S-format: imm[11:5] | rs2 | rs1 | func3 | imm[4:0] | opcode
+inline uint32_t encodeS(uint32_t opcode, uint32_t func3, uint32_t rs1, uint32_t rs2, int32_t imm) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    return (((u >> 5) & 0x7F) << 25) | ((rs2 & 0x1F) << 20) | ((rs1 & 0x1F) << 15) |
+           ((func3 & 0x7) << 12) | ((u & 0x1F) << 7) | (opcode & 0x7F);
+}
+
+// SB-format: imm[12|10:5] | rs2 | rs1 | func3 | imm[4:1|11] | opcode
+inline uint32_t encodeSB(uint32_t opcode, uint32_t func3, uint32_t rs1, uint32_t rs2, int32_t offset) {
+    uint32_t u = static_cast<uint32_t>(offset);
+    return (((u >> 12) & 0x1) << 31) | (((u >> 5) & 0x3F) << 25) | ((rs2 & 0x1F) << 20) |
+           ((rs1 & 0x1F) << 15) | ((func3 & 0x7) << 12) | (((u >> 1) & 0xF) << 8) |
+           (((u >> 11) & 0x1) << 7) | (opcode & 0x7F);
+}
+
+// U-format: imm[19:0] | rd | opcode (imm is the upper 20 bits of the value)
+inline uint32_t encodeU(uint32_t opcode, uint32_t rd, int32_t imm) {
+    return ((static_cast<uint32_t>(imm) & 0xFFFFF) << 12) | ((rd & 0x1F) << 7) | (opcode & 0x7F);
+}
+
+// UJ-format: imm[20|10:1|11|19:12] | rd | opcode
+inline uint32_t encodeUJ(uint32_t opcode, uint32_t rd, int32_t offset) {
+    uint32_t u = static_cast<uint32_t>(offset);
+    return (((u >> 20) & 0x1) << 31) | (((u >> 1) & 0x3FF) << 21) | (((u >> 11) & 0x1) << 20) |
+           (((u >> 12) & 0xFF) << 12) | ((rd & 0x1F) << 7) | (opcode & 0x7F);
+}
+
+// RV32C instructions are 16 bits and never have both low bits set; in a code
+// vector they are stored zero-extended in a 32-bit slot
+inline bool isCompressedWord(uint32_t word) { return (word & 0x3) != 0x3; }
+inline uint32_t instructionLength(uint32_t word) { return isCompressedWord(word) ? 2 : 4; }
+
+// Field extraction, shared by the simulator and the disassembler
+inline uint32_t decodeOpcode(uint32_t word) { return word & 0x7F; }
+inline uint32_t decodeRd(uint32_t word) { return (word >> 7) & 0x1F; }
+inline uint32_t decodeFunc3(uint32_t word) { return (word >> 12) & 0x7; }
+inline uint32_t decodeRs1(uint32_t word) { return (word >> 15) & 0x1F; }
+inline uint32_t decodeRs2(uint32_t word) { return (word >> 20) & 0x1F; }
+inline uint32_t decodeFunc7(uint32_t word) { return word >> 25; }
+
+// Sign-extend the low bits of value
+inline int32_t signExtend(uint32_t value, int bits) {
+    return static_cast<int32_t>(value << (32 - bits)) >> (32 - bits);
+}
+
+// Sign-extended immediates
+inline int32_t decodeImmI(uint32_t word) {
+    return signExtend(word >> 20, 12);
+}
+
+inline int32_t decodeImmS(uint32_t word) {
+    return signExtend(((word >> 25) << 5) | ((word >> 7) & 0x1F), 12);
+}
+
+inline int32_t decodeImmSB(uint32_t word) {
+    return signExtend(((word >> 31) << 12) | (((word >> 7) & 0x1) << 11) | (((word >> 25) & 0x3F) << 5) |
+                      (((word >> 8) & 0xF) << 1), 13);
+}
+
+// The 20-bit upper immediate field, sign-extended (the value is this << 12)
+inline int32_t decodeImmU(uint32_t word) {
+    return signExtend(word >> 12, 20);
+}
+
+inline int32_t decodeImmUJ(uint32_t word) {
+    return signExtend(((word >> 31) << 20) | (((word >> 12) & 0xFF) << 12) | (((word >> 20) & 0x1) << 11) |
+                      (((word >> 21) & 0x3FF) << 1), 21);
+}
+
+#endif
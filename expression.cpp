@@ -0,0 +1,257 @@
+#include <cctype>
+#include <charconv>
+#include "expression.h"
+#include "lexer.h"
+
+using namespace std;
+
+// Unsigned integer in any of parseInteger's bases, negated when negative.
+// False when the result does not fit in int64_t.
+static bool parseMagnitude(string_view text, bool negative, int64_t& value) {
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) base = 16;
+    else if (text.size() > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B')) base = 2;
+    if (base != 10) text.remove_prefix(2);
+    uint64_t magnitude = 0;
+    auto result = from_chars(text.data(), text.data() + text.size(), magnitude, base);
+    if (text.empty() || result.ec != errc() || result.ptr != text.data() + text.size()) return false;
+    if (magnitude > static_cast<uint64_t>(INT64_MAX) + negative) return false; // Only -2^63 has no positive twin
+    value = static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+    return true;
+}
+
+bool parseInteger(string_view text, int64_t& value) {
+    bool negative = false;
+    if (!text.empty() && (text[0] == '-' || text[0] == '+')) {
+        negative = text[0] == '-';
+        text.remove_prefix(1);
+    }
+    return parseMagnitude(text, negative, value);
+}
+
+namespace {
+
+// Value of a character literal of charLiteralLength bytes
+bool parseCharLiteral(string_view literal, int64_t& value) {
+    if (literal.size() == 3) {
+        value = static_cast<unsigned char>(literal[1]);
+        return true;
+    }
+    switch (literal[2]) {
+        case 'n': value = '\n'; return true;
+        case 't': value = '\t'; return true;
+        case 'r': value = '\r'; return true;
+        case '0': value = 0; return true;
+        case '\\':
+        case '\'':
+        case '"': value = literal[2]; return true;
+    }
+    return false;
+}
+
+bool isNameStart(char c) {
+    return isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$';
+}
+
+bool isNameChar(char c) {
+    return isNameStart(c) || isdigit(static_cast<unsigned char>(c));
+}
+
+// Recursive descent over one operand, one function per precedence level.
+// Values are computed in 64 bits; the caller range-checks the result.
+class ExpressionParser {
+public:
+    ExpressionParser(string_view text, SymbolTable& symbolTable) : text(text), symbolTable(symbolTable) {}
+
+    bool parse(Expression& result) {
+        return parseOr(result) && (skipBlanks(), position == text.size());
+    }
+
+private:
+    string_view text;
+    SymbolTable& symbolTable;
+    size_t position = 0;
+
+    void skipBlanks() {
+        while (position < text.size() && (text[position] == ' ' || text[position] == '\t')) position++;
+    }
+
+    // Consume op if it comes next
+    bool accept(string_view op) {
+        skipBlanks();
+        if (text.substr(position, op.size()) != op) return false;
+        position += op.size();
+        return true;
+    }
+
+    // Only + and - accept a label, and at most one side may hold it
+    static bool combine(Expression& left, const Expression& right, char op) {
+        if (left.modifier != Modifier::None || right.modifier != Modifier::None) return false;
+        if (!left.isConstant() || !right.isConstant()) {
+            if (op == '+' && left.isConstant() != right.isConstant()) {
+                if (left.isConstant()) left.symbol = right.symbol;
+            } else if (!(op == '-' && right.isConstant())) {
+                return false;
+            }
+        }
+        int64_t a = left.value, b = right.value;
+        switch (op) {
+            case '+': left.value = a + b; break;
+            case '-': left.value = a - b; break;
+            case '*': left.value = a * b; break;
+            case '/':
+            case '%':
+                if (b == 0) return false;
+                left.value = op == '/' ? a / b : a % b;
+                break;
+            case '<':
+            case '>':
+                if (b < 0 || b > 63) return false;
+                left.value = op == '<' ? static_cast<int64_t>(static_cast<uint64_t>(a) << b) : a >> b;
+                break;
+            case '&': left.value = a & b; break;
+            case '^': left.value = a ^ b; break;
+            case '|': left.value = a | b; break;
+        }
+        return true;
+    }
+
+    bool parseOr(Expression& result) {
+        if (!parseXor(result)) return false;
+        Expression right;
+        while (accept("|")) {
+            if (!parseXor(right) || !combine(result, right, '|')) return false;
+        }
+        return true;
+    }
+
+    bool parseXor(Expression& result) {
+        if (!parseAnd(result)) return false;
+        Expression right;
+        while (accept("^")) {
+            if (!parseAnd(right) || !combine(result, right, '^')) return false;
+        }
+        return true;
+    }
+
+    bool parseAnd(Expression& result) {
+        if (!parseShift(result)) return false;
+        Expression right;
+        while (accept("&")) {
+            if (!parseShift(right) || !combine(result, right, '&')) return false;
+        }
+        return true;
+    }
+
+    bool parseShift(Expression& result) {
+        if (!parseSum(result)) return false;
+        Expression right;
+        for (;;) {
+            char op = accept("<<") ? '<' : accept(">>") ? '>' : 0;
+            if (op == 0) return true;
+            if (!parseSum(right) || !combine(result, right, op)) return false;
+        }
+    }
+
+    bool parseSum(Expression& result) {
+        if (!parseProduct(result)) return false;
+        Expression right;
+        for (;;) {
+            char op = accept("+") ? '+' : accept("-") ? '-' : 0;
+            if (op == 0) return true;
+            if (!parseProduct(right) || !combine(result, right, op)) return false;
+        }
+    }
+
+    bool parseProduct(Expression& result) {
+        if (!parseUnary(result)) return false;
+        Expression right;
+        for (;;) {
+            char op = accept("*") ? '*' : accept("/") ? '/' : accept("%") ? '%' : 0;
+            if (op == 0) return true;
+            if (!parseUnary(right) || !combine(result, right, op)) return false;
+        }
+    }
+
+    bool parseUnary(Expression& result) {
+        char op = accept("-") ? '-' : accept("+") ? '+' : accept("~") ? '~' : 0;
+        if (op == 0) return parsePrimary(result);
+        // A minus sign belongs to the integer after it, which may then be -2^63
+        skipBlanks();
+        if (op == '-' && position < text.size() && isdigit(static_cast<unsigned char>(text[position]))) {
+            return parsePrimary(result, true);
+        }
+        if (!parseUnary(result)) return false;
+        if (op == '+') return true;
+        if (!result.isConstant()) return false;
+        result.value = op == '-' ? -result.value : ~result.value;
+        return true;
+    }
+
+    bool parsePrimary(Expression& result, bool negated = false) {
+        result = Expression();
+        skipBlanks();
+        if (position == text.size()) return false;
+        char c = text[position];
+        if (c == '(') {
+            position++;
+            return parseOr(result) && accept(")");
+        }
+        if (c == '%') return parseModifier(result);
+        if (c == '\'') {
+            size_t length = charLiteralLength(text.substr(position));
+            if (length == 0 || !parseCharLiteral(text.substr(position, length), result.value)) return false;
+            position += length;
+            return true;
+        }
+
+        size_t start = position;
+        while (position < text.size() && isNameChar(text[position])) position++;
+        string_view token = text.substr(start, position - start);
+        if (token.empty()) return false;
+        if (isdigit(static_cast<unsigned char>(c))) return parseMagnitude(token, negated, result.value);
+
+        int32_t constant;
+        if (symbolTable.findConstant(token, constant)) {
+            result.value = constant;
+            return true;
+        }
+        result.symbol = symbolTable.intern(token);
+        return true;
+    }
+
+    // %hi and %lo split a 32-bit value the way lui/auipc + addi rebuild it
+    bool parseModifier(Expression& result) {
+        static constexpr struct {
+            string_view name;
+            Modifier modifier;
+        } modifiers[] = {{"%pcrel_hi(", Modifier::PcrelHi},
+                         {"%pcrel_lo(", Modifier::PcrelLo},
+                         {"%hi(", Modifier::Hi},
+                         {"%lo(", Modifier::Lo}};
+        for (const auto& entry : modifiers) {
+            if (text.substr(position, entry.name.size()) != entry.name) continue;
+            position += entry.name.size();
+            if (!parseOr(result) || !accept(")") || result.modifier != Modifier::None) return false;
+            if (!result.isConstant()) {
+                result.modifier = entry.modifier;
+                return true;
+            }
+            if (entry.modifier == Modifier::PcrelHi || entry.modifier == Modifier::PcrelLo) return false;
+            uint32_t value = static_cast<uint32_t>(result.value);
+            uint32_t upper = (value + 0x800) >> 12;
+            result.value = entry.modifier == Modifier::Hi
+                               ? static_cast<int64_t>(upper & 0xFFFFF)
+                               : static_cast<int64_t>(static_cast<int32_t>(value - (upper << 12)));
+            return true;
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+bool evaluateExpression(string_view text, SymbolTable& symbolTable, Expression& result) {
+    ExpressionParser parser(text, symbolTable);
+    return parser.parse(result);
+}
@@ -0,0 +1,33 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+#include <cstdint>
+#include <string_view>
+#include "symbol_table.h"
+
+// Relocation operator applied to a symbolic operand. The instruction decides
+// between the upper and lower part; the modifier also tells an absolute %lo
+// from a %pcrel_lo paired with the auipc before it (see layoutText).
+enum class Modifier : uint8_t { None, Hi, Lo, PcrelHi, PcrelLo };
+
+// Value of an operand expression: a constant, or a label plus a constant addend
+struct Expression {
+    int64_t value = 0;
+    SymbolId symbol = noSymbolId;
+    Modifier modifier = Modifier::None;
+
+    bool isConstant() const { return symbol == noSymbolId; }
+};
+
+// Parse a decimal, 0x-prefixed hex or 0b-prefixed binary integer with an
+// optional sign
+bool parseInteger(std::string_view text, int64_t& value);
+
+// Evaluate an operand expression. Terms are integers, character literals
+// ('a', '\n'), .equ/.set constants and labels; operators are + - * / % << >> & | ^ ~ and parentheses, with C
+// precedence. %hi(e), %lo(e), %pcrel_hi(e) and %pcrel_lo(e) fold when e is
+// constant. Any other name is a label, interned in symbolTable; it may only
+// appear as label + constant or label - constant, and a modifier applied to
+// a label must make up the whole operand. False on a malformed expression.
+bool evaluateExpression(std::string_view text, SymbolTable& symbolTable, Expression& result);
+
+#endif
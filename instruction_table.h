@@ -0,0 +1,163 @@
+#ifndef INSTRUCTION_TABLE_H
+#define INSTRUCTION_TABLE_H
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Instruction formats understood by the encoder
+enum class Format : uint8_t { R, I, S, SB, U, UJ };
+
+// How the operands of an instruction are written in the source
+enum class OperandShape : uint8_t {
+    RegRegReg,   // rd, rs1, rs2
+    RegRegImm,   // rd, rs1, imm
+    RegMem,      // rd, imm(rs1)
+    StoreMem,    // rs2, imm(rs1)
+    RegRegLabel, // rs1, rs2, label/offset
+    RegImm,      // rd, imm
+    RegLabel     // rd, label/offset
+};
+
+// One row per supported mnemonic
+struct InstructionDesc {
+    std::string_view mnemonic;
+    Format format;
+    uint8_t opcode;
+    uint8_t func3;
+    uint8_t func7;
+    OperandShape shape;
+};
+
+// Adding an instruction is a one-row change here
+inline constexpr InstructionDesc instructionTable[] = {
+    // R-format
+    {"add", Format::R, 0x33, 0x0, 0x00, OperandShape::RegRegReg},
+    {"sub", Format::R, 0x33, 0x0, 0x20, OperandShape::RegRegReg},
+    {"xor", Format::R, 0x33, 0x4, 0x00, OperandShape::RegRegReg},
+    {"or", Format::R, 0x33, 0x6, 0x00, OperandShape::RegRegReg},
+    {"and", Format::R, 0x33, 0x7, 0x00, OperandShape::RegRegReg},
+    {"sll", Format::R, 0x33, 0x1, 0x00, OperandShape::RegRegReg},
+    {"slt", Format::R, 0x33, 0x2, 0x00, OperandShape::RegRegReg},
+    {"sra", Format::R, 0x33, 0x5, 0x20, OperandShape::RegRegReg},
+    {"srl", Format::R, 0x33, 0x5, 0x00, OperandShape::RegRegReg},
+    {"mul", Format::R, 0x33, 0x0, 0x01, OperandShape::RegRegReg},
+    {"div", Format::R, 0x33, 0x4, 0x01, OperandShape::RegRegReg},
+    {"rem", Format::R, 0x33, 0x6, 0x01, OperandShape::RegRegReg},
+
+    // I-format
+    {"addi", Format::I, 0x13, 0x0, 0x00, OperandShape::RegRegImm},
+    {"andi", Format::I, 0x13, 0x7, 0x00, OperandShape::RegRegImm},
+    {"ori", Format::I, 0x13, 0x6, 0x00, OperandShape::RegRegImm},
+    {"lb", Format::I, 0x03, 0x0, 0x00, OperandShape::RegMem},
+    {"lh", Format::I, 0x03, 0x1, 0x00, OperandShape::RegMem},
+    {"lw", Format::I, 0x03, 0x2, 0x00, OperandShape::RegMem},
+    {"ld", Format::I, 0x03, 0x3, 0x00, OperandShape::RegMem},
+    {"jalr", Format::I, 0x67, 0x0, 0x00, OperandShape::RegMem},
+
+    // S-format
+    {"sb", Format::S, 0x23, 0x0, 0x00, OperandShape::StoreMem},
+    {"sh", Format::S, 0x23, 0x1, 0x00, OperandShape::StoreMem},
+    {"sw", Format::S, 0x23, 0x2, 0x00, OperandShape::StoreMem},
+    {"sd", Format::S, 0x23, 0x3, 0x00, OperandShape::StoreMem},
+
+    // SB-format
+    {"beq", Format::SB, 0x63, 0x0, 0x00, OperandShape::RegRegLabel},
+    {"bne", Format::SB, 0x63, 0x1, 0x00, OperandShape::RegRegLabel},
+    {"blt", Format::SB, 0x63, 0x4, 0x00, OperandShape::RegRegLabel},
+    {"bge", Format::SB, 0x63, 0x5, 0x00, OperandShape::RegRegLabel},
+
+    // U-format
+    {"lui", Format::U, 0x37, 0x0, 0x00, OperandShape::RegImm},
+    {"auipc", Format::U, 0x17, 0x0, 0x00, OperandShape::RegImm},
+
+    // UJ-format
+    {"jal", Format::UJ, 0x6F, 0x0, 0x00, OperandShape::RegLabel},
+};
+
+inline constexpr size_t instructionCount = sizeof(instructionTable) / sizeof(instructionTable[0]);
+
+// Perfect hash over the mnemonics. The seed is searched at compile time so
+// that every mnemonic lands in its own slot.
+inline constexpr size_t mnemonicSlots = 64;
+static_assert(instructionCount < 0xFF, "slot table stores indices as uint8_t");
+
+constexpr uint32_t mnemonicHash(std::string_view s, uint32_t seed) {
+    uint32_t h = seed;
+    for (char c : s) h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+    return (h ^ (h >> 15)) & (mnemonicSlots - 1);
+}
+
+constexpr bool seedIsPerfect(uint32_t seed) {
+    bool used[mnemonicSlots] = {};
+    for (const InstructionDesc& desc : instructionTable) {
+        uint32_t slot = mnemonicHash(desc.mnemonic, seed);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findPerfectSeed() {
+    for (uint32_t seed = 2166136261u; seed < 2166136261u + 100000; seed++) {
+        if (seedIsPerfect(seed)) return seed;
+    }
+    return 0;
+}
+
+inline constexpr uint32_t mnemonicSeed = findPerfectSeed();
+static_assert(mnemonicSeed != 0, "no perfect hash seed found; grow mnemonicSlots");
+
+constexpr std::array<uint8_t, mnemonicSlots> buildMnemonicSlots() {
+    std::array<uint8_t, mnemonicSlots> slots{};
+    for (auto& slot : slots) slot = 0xFF;
+    for (size_t i = 0; i < instructionCount; i++) {
+        slots[mnemonicHash(instructionTable[i].mnemonic, mnemonicSeed)] = static_cast<uint8_t>(i);
+    }
+    return slots;
+}
+
+inline constexpr std::array<uint8_t, mnemonicSlots> mnemonicSlotTable = buildMnemonicSlots();
+
+// Look up a mnemonic; returns nullptr if it is not a known instruction
+constexpr const InstructionDesc* findInstruction(std::string_view mnemonic) {
+    uint8_t index = mnemonicSlotTable[mnemonicHash(mnemonic, mnemonicSeed)];
+    if (index == 0xFF || instructionTable[index].mnemonic != mnemonic) return nullptr;
+    return &instructionTable[index];
+}
+
+// Row index of a mnemonic known to be in the table, for building
+// instructions in code (pseudo-instruction expansion, relaxation)
+constexpr uint8_t instructionId(std::string_view mnemonic) {
+    return static_cast<uint8_t>(findInstruction(mnemonic) - instructionTable);
+}
+
+// Find the row whose fixed encoding bits match a machine word; returns
+// nullptr for words that are not a supported instruction
+constexpr const InstructionDesc* findInstructionByEncoding(uint32_t word) {
+    uint32_t opcode = word & 0x7F;
+    uint32_t func3 = (word >> 12) & 0x7;
+    uint32_t func7 = word >> 25;
+    for (const InstructionDesc& desc : instructionTable) {
+        if (desc.opcode != opcode) continue;
+        if (desc.format == Format::U || desc.format == Format::UJ) return &desc;
+        if (desc.func3 != func3) continue;
+        if (desc.format == Format::R && desc.func7 != func7) continue;
+        return &desc;
+    }
+    return nullptr;
+}
+
+// Short format name used in listings ("R", "I", "S", "SB", "U", "UJ")
+constexpr const char* formatName(Format format) {
+    switch (format) {
+        case Format::R: return "R";
+        case Format::I: return "I";
+        case Format::S: return "S";
+        case Format::SB: return "SB";
+        case Format::U: return "U";
+        case Format::UJ: return "UJ";
+    }
+    return "";
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lexer.h"
+
+using namespace std;
+
+SourceBuffer::~SourceBuffer() {
+    release();
+}
+
+void SourceBuffer::release() {
+    if (mapping != nullptr) munmap(mapping, length);
+    mapping = nullptr;
+    data = nullptr;
+    length = 0;
+    fallback.clear();
+}
+
+// Map the file, or read it fully when it is stdin or not mappable
+bool SourceBuffer::open(const string& filename) {
+    release();
+
+    int fd = filename == "-" ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fd != STDIN_FILENO && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+            mapping = mapped;
+            data = static_cast<const char*>(mapped);
+            length = info.st_size;
+            close(fd);
+            return true;
+        }
+    }
+
+    char chunk[1 << 16];
+    ssize_t count;
+    while ((count = read(fd, chunk, sizeof(chunk))) > 0) {
+        fallback.append(chunk, count);
+    }
+    if (fd != STDIN_FILENO) close(fd);
+    if (count < 0) return false;
+
+    data = fallback.data();
+    length = fallback.size();
+    return true;
+}
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static string_view trim(string_view text) {
+    size_t first = 0;
+    while (first < text.size() && isBlank(text[first])) first++;
+    size_t last = text.size();
+    while (last > first && isBlank(text[last - 1])) last--;
+    return text.substr(first, last - first);
+}
+
+size_t charLiteralLength(string_view text) {
+    if (text.size() < 3 || text[0] != '\'' || text[1] == '\n') return 0;
+    if (text[1] != '\\') return text[2] == '\'' && text[1] != '\'' ? 3 : 0;
+    return text.size() >= 4 && text[3] == '\'' ? 4 : 0;
+}
+
+// Characters to step over at text[position]: a whole character literal, so
+// that a blank or comma in one does not end a token
+static size_t tokenStep(string_view text, size_t position) {
+    return text[position] == '\'' ? max<size_t>(charLiteralLength(text.substr(position)), 1) : 1;
+}
+
+bool nextToken(string_view& cursor, string_view& token) {
+    size_t start = 0;
+    while (start < cursor.size() && (isBlank(cursor[start]) || cursor[start] == ',')) start++;
+    if (start == cursor.size()) {
+        cursor = string_view();
+        return false;
+    }
+    size_t end = start;
+    while (end < cursor.size() && !isBlank(cursor[end]) && cursor[end] != ',') end += tokenStep(cursor, end);
+    token = cursor.substr(start, end - start);
+    cursor.remove_prefix(end);
+    return true;
+}
+
+bool nextOperand(string_view& cursor, string_view& operand, bool commaSeparated) {
+    if (!commaSeparated) return nextToken(cursor, operand);
+    cursor = trim(cursor);
+    if (cursor.empty()) return false;
+    size_t comma = 0;
+    while (comma < cursor.size() && cursor[comma] != ',') comma += tokenStep(cursor, comma);
+    operand = trim(cursor.substr(0, comma));
+    cursor = comma >= cursor.size() ? string_view() : cursor.substr(comma + 1);
+    return true;
+}
+
+// Trim blanks off both ends of [first, last): the leading ones with the
+// blank mask, the few trailing ones directly
+string_view Lexer::trimmed(size_t first, size_t last) {
+    first = scanner.findNot(LineScanner::Blank, first, last);
+    while (last > first && isBlank(source[last - 1])) last--;
+    return source.substr(first, last - first);
+}
+
+bool Lexer::next(SourceLine& line) {
+    const size_t size = source.size();
+    while (position < size) {
+        // One sweep over the line's structural characters finds its end, its
+        // comment and the first ':'. A quote switches to a byte loop for the
+        // rest of the line, since '#', ':' and ',' in a string or character
+        // literal are text.
+        size_t begin = position;
+        size_t colon = string_view::npos, textEnd, end;
+        size_t p = scanner.find(LineScanner::Structural, begin, size);
+        while (p < size && source[p] == ':') {
+            if (colon == string_view::npos) colon = p;
+            p = scanner.find(LineScanner::Structural, p + 1, size);
+        }
+        bool quoted = p < size && (source[p] == '"' || source[p] == '\'');
+        if (quoted) {
+            for (bool inString = false; p < size && source[p] != '\n'; p++) {
+                char c = source[p];
+                if (c == '"') inString = !inString;
+                else if (inString) continue;
+                else if (c == '\'') p += tokenStep(source, p) - 1;
+                else if (c == '#') break;
+                else if (c == ':' && colon == string_view::npos) colon = p;
+            }
+        }
+        textEnd = p;
+        end = p < size && source[p] != '\n' ? scanner.find(LineScanner::Newline, p, size) : p;
+        position = end + 1;
+        lineNumber++;
+
+        string_view text = trimmed(begin, textEnd);
+        if (text.empty()) continue;
+
+        line = SourceLine();
+        line.lineNumber = lineNumber;
+        line.text = text;
+
+        string_view statement = text;
+        if (colon != string_view::npos) {
+            size_t textStart = text.data() - source.data();
+            line.hasLabel = true;
+            line.label = trimmed(textStart, colon);
+            statement = trimmed(colon + 1, textStart + text.size());
+        }
+        line.statement = statement;
+
+        if (quoted) {
+            string_view cursor = statement;
+            if (!nextToken(cursor, line.mnemonic)) return true;
+            line.rest = trim(cursor);
+            cursor = line.rest;
+            bool commas = line.rest.find(',') != string_view::npos;
+            string_view operand;
+            while (nextOperand(cursor, operand, commas)) {
+                if (line.operandCount < SourceLine::maxOperands) line.operands[line.operandCount] = operand;
+                line.operandCount++;
+            }
+            return true;
+        }
+
+        // Tokens as nextToken and nextOperand split them, found with the masks
+        size_t statementStart = statement.data() - source.data();
+        size_t statementEnd = statementStart + statement.size();
+        size_t mnemonicStart = scanner.findNot(LineScanner::Separator, statementStart, statementEnd);
+        if (mnemonicStart == statementEnd) return true;
+        size_t mnemonicEnd = scanner.find(LineScanner::Separator, mnemonicStart, statementEnd);
+        line.mnemonic = source.substr(mnemonicStart, mnemonicEnd - mnemonicStart);
+        line.rest = trimmed(mnemonicEnd, statementEnd);
+        size_t restStart = line.rest.data() - source.data();
+        size_t restEnd = restStart + line.rest.size();
+        bool commas = scanner.find(LineScanner::Comma, restStart, restEnd) < restEnd;
+        for (size_t start = restStart;;) {
+            start = scanner.findNot(commas ? LineScanner::Blank : LineScanner::Separator, start, restEnd);
+            if (start == restEnd) break;
+            size_t end = scanner.find(commas ? LineScanner::Comma : LineScanner::Separator, start, restEnd);
+            if (line.operandCount < SourceLine::maxOperands) {
+                line.operands[line.operandCount] = commas ? trimmed(start, end) : source.substr(start, end - start);
+            }
+            line.operandCount++;
+            if (end == restEnd) break;
+            start = end + commas;
+        }
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,76 @@
+#ifndef LEXER_H
+#define LEXER_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "line_scanner.h"
+
+// Whole input file as one contiguous read-only buffer. Regular files are
+// memory-mapped; stdin ("-"), pipes and anything mmap refuses are read into
+// an owned string instead.
+class SourceBuffer {
+private:
+    const char* data = nullptr;
+    size_t length = 0;
+    void* mapping = nullptr;
+    std::string fallback;
+
+    void release();
+
+public:
+    SourceBuffer() = default;
+    ~SourceBuffer();
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    bool open(const std::string& filename);
+    std::string_view text() const { return std::string_view(data, length); }
+};
+
+// Tokens of one non-empty source line, all slices of the source buffer
+struct SourceLine {
+    static constexpr int maxOperands = 3;
+
+    uint32_t lineNumber = 0;
+    std::string_view text;      // Line with comment and surrounding whitespace removed
+    bool hasLabel = false;
+    std::string_view label;     // Text before ':'
+    std::string_view mnemonic;  // First word after the label; directives start with '.'
+    std::string_view rest;      // Everything after the mnemonic, trimmed
+    std::string_view statement; // Mnemonic and operands, i.e. text without the label
+    std::string_view operands[maxOperands];
+    int operandCount = 0;       // Operands on the line; only the first maxOperands are kept
+};
+
+// Length of the character literal ('a', or an escape such as '\n') at the
+// start of text, or 0 if there is none
+size_t charLiteralLength(std::string_view text);
+// Pull the next comma/whitespace separated token off the front of cursor
+bool nextToken(std::string_view& cursor, std::string_view& token);
+// Pull the next operand off the front of cursor. Operands are separated by
+// commas, so they may contain blanks ("label + 4"), or by whitespace when
+// the statement has no commas at all.
+bool nextOperand(std::string_view& cursor, std::string_view& operand, bool commaSeparated);
+
+// Splits a source buffer into SourceLines without copying any text
+class Lexer {
+private:
+    std::string_view source;
+    size_t position = 0;
+    uint32_t lineNumber = 0;
+    LineScanner scanner;
+
+    std::string_view trimmed(size_t first, size_t last);
+
+public:
+    // firstLine is the line number before the first line of source, for
+    // lexing a slice of a larger file
+    explicit Lexer(std::string_view source, uint32_t firstLine = 0)
+        : source(source), lineNumber(firstLine), scanner(source) {}
+
+    // Advance to the next line that has a label or a statement
+    bool next(SourceLine& line);
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include <cstring>
+#include "line_scanner.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LINE_SCANNER_X86 1
+#endif
+
+using namespace std;
+
+namespace {
+
+// Fills masks[kind][block] for count blocks of 64 bytes starting at data
+using BlockScanner = void (*)(const char* data, size_t count, uint64_t (*masks)[LineScanner::windowBlocks]);
+
+void scanScalar(const char* data, size_t count, uint64_t (*masks)[LineScanner::windowBlocks]) {
+    for (size_t block = 0; block < count; block++) {
+        uint64_t newline = 0, structural = 0, comma = 0, blank = 0;
+        for (size_t i = 0; i < LineScanner::blockSize; i++) {
+            char c = data[block * LineScanner::blockSize + i];
+            uint64_t bit = uint64_t(1) << i;
+            if (c == '\n') newline |= bit;
+            if (c == '\n' || c == '#' || c == ':' || c == '"' || c == '\'') structural |= bit;
+            if (c == ',') comma |= bit;
+            if (c == ' ' || c == '\t' || c == '\r') blank |= bit;
+        }
+        masks[LineScanner::Newline][block] = newline;
+        masks[LineScanner::Structural][block] = structural;
+        masks[LineScanner::Comma][block] = comma;
+        masks[LineScanner::Blank][block] = blank;
+        masks[LineScanner::Separator][block] = blank | comma;
+    }
+}
+
+#ifdef LINE_SCANNER_X86
+
+// Four 16-byte compares per mask and block
+__attribute__((target("sse2"))) void scanSse2(const char* data, size_t count,
+                                              uint64_t (*masks)[LineScanner::windowBlocks]) {
+    const __m128i newlineChar = _mm_set1_epi8('\n'), hashChar = _mm_set1_epi8('#'), colonChar = _mm_set1_epi8(':');
+    const __m128i quoteChar = _mm_set1_epi8('"'), apostropheChar = _mm_set1_epi8('\'');
+    const __m128i commaChar = _mm_set1_epi8(',');
+    const __m128i spaceChar = _mm_set1_epi8(' '), tabChar = _mm_set1_epi8('\t'), returnChar = _mm_set1_epi8('\r');
+    for (size_t block = 0; block < count; block++) {
+        uint64_t newline = 0, structural = 0, comma = 0, blank = 0;
+        for (int part = 0; part < 4; part++) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + block * 64 + part * 16));
+            __m128i isNewline = _mm_cmpeq_epi8(bytes, newlineChar);
+            __m128i isQuote = _mm_or_si128(_mm_cmpeq_epi8(bytes, quoteChar), _mm_cmpeq_epi8(bytes, apostropheChar));
+            __m128i isStructural = _mm_or_si128(_mm_or_si128(isNewline, _mm_cmpeq_epi8(bytes, hashChar)),
+                                                _mm_or_si128(_mm_cmpeq_epi8(bytes, colonChar), isQuote));
+            __m128i isBlank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, spaceChar), _mm_cmpeq_epi8(bytes, tabChar)),
+                                           _mm_cmpeq_epi8(bytes, returnChar));
+            int shift = part * 16;
+            newline |= uint64_t(uint16_t(_mm_movemask_epi8(isNewline))) << shift;
+            structural |= uint64_t(uint16_t(_mm_movemask_epi8(isStructural))) << shift;
+            comma |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, commaChar)))) << shift;
+            blank |= uint64_t(uint16_t(_mm_movemask_epi8(isBlank))) << shift;
+        }
+        masks[LineScanner::Newline][block] = newline;
+        masks[LineScanner::Structural][block] = structural;
+        masks[LineScanner::Comma][block] = comma;
+        masks[LineScanner::Blank][block] = blank;
+        masks[LineScanner::Separator][block] = blank | comma;
+    }
+}
+
+// Two 32-byte compares per mask and block
+__attribute__((target("avx2"))) void scanAvx2(const char* data, size_t count,
+                                              uint64_t (*masks)[LineScanner::windowBlocks]) {
+    const __m256i newlineChar = _mm256_set1_epi8('\n'), hashChar = _mm256_set1_epi8('#');
+    const __m256i colonChar = _mm256_set1_epi8(':'), quoteChar = _mm256_set1_epi8('"');
+    const __m256i apostropheChar = _mm256_set1_epi8('\'');
+    const __m256i commaChar = _mm256_set1_epi8(','), spaceChar = _mm256_set1_epi8(' ');
+    const __m256i tabChar = _mm256_set1_epi8('\t'), returnChar = _mm256_set1_epi8('\r');
+    for (size_t block = 0; block < count; block++) {
+        uint64_t newline = 0, structural = 0, comma = 0, blank = 0;
+        for (int part = 0; part < 2; part++) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + block * 64 + part * 32));
+            __m256i isNewline = _mm256_cmpeq_epi8(bytes, newlineChar);
+            __m256i isQuote =
+                _mm256_or_si256(_mm256_cmpeq_epi8(bytes, quoteChar), _mm256_cmpeq_epi8(bytes, apostropheChar));
+            __m256i isStructural = _mm256_or_si256(_mm256_or_si256(isNewline, _mm256_cmpeq_epi8(bytes, hashChar)),
+                                                   _mm256_or_si256(_mm256_cmpeq_epi8(bytes, colonChar), isQuote));
+            __m256i isBlank =
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, spaceChar), _mm256_cmpeq_epi8(bytes, tabChar)),
+                                _mm256_cmpeq_epi8(bytes, returnChar));
+            int shift = part * 32;
+            newline |= uint64_t(uint32_t(_mm256_movemask_epi8(isNewline))) << shift;
+            structural |= uint64_t(uint32_t(_mm256_movemask_epi8(isStructural))) << shift;
+            comma |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, commaChar)))) << shift;
+            blank |= uint64_t(uint32_t(_mm256_movemask_epi8(isBlank))) << shift;
+        }
+        masks[LineScanner::Newline][block] = newline;
+        masks[LineScanner::Structural][block] = structural;
+        masks[LineScanner::Comma][block] = comma;
+        masks[LineScanner::Blank][block] = blank;
+        masks[LineScanner::Separator][block] = blank | comma;
+    }
+}
+
+#endif
+
+struct ScannerChoice {
+    BlockScanner scan;
+    const char* name;
+};
+
+ScannerChoice chooseScanner() {
+#ifdef LINE_SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {scanAvx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {scanSse2, "sse2"};
+#endif
+    return {scanScalar, "scalar"};
+}
+
+const ScannerChoice scanner = chooseScanner();
+
+} // namespace
+
+const char* LineScanner::implementation() {
+    return scanner.name;
+}
+
+// Scan the window holding position. The last, partial block is scanned from
+// a zero-padded copy.
+void LineScanner::load(size_t position) {
+    constexpr size_t windowSize = blockSize * windowBlocks;
+    windowStart = position / windowSize * windowSize;
+    windowEnd = min(windowStart + windowSize, source.size());
+    size_t bytes = windowEnd - windowStart;
+    size_t fullBlocks = bytes / blockSize;
+    scanner.scan(source.data() + windowStart, fullBlocks, masks);
+    if (bytes % blockSize != 0) {
+        char tail[blockSize] = {};
+        memcpy(tail, source.data() + windowStart + fullBlocks * blockSize, bytes % blockSize);
+        uint64_t tailMasks[maskCount][windowBlocks];
+        scanner.scan(tail, 1, tailMasks);
+        for (int mask = 0; mask < maskCount; mask++) masks[mask][fullBlocks] = tailMasks[mask][0];
+    }
+}
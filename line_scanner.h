@@ -0,0 +1,59 @@
+#ifndef LINE_SCANNER_H
+#define LINE_SCANNER_H
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Bitmasks of the characters the lexer looks for, one bit per source byte.
+// The masks are computed for a 4 KiB window of the source at a time, 64
+// bytes per step with AVX2 or SSE2 where the CPU has them (chosen at run
+// time) and a scalar loop elsewhere, so that finding the end of a line, its
+// comment, label colon and operand commas needs no byte-by-byte search.
+class LineScanner {
+public:
+    enum Mask {
+        Newline,
+        Structural, // '\n', '#', ':' and quotes: what ends a line's statement or needs care
+        Comma,
+        Blank,      // ' ', '\t', '\r'
+        Separator,  // Blank or comma: what ends a token
+        maskCount
+    };
+
+    explicit LineScanner(std::string_view source) : source(source) {}
+
+    // Position of the first byte in [position, limit) that is in mask, or
+    // not in it, or limit if there is none
+    size_t find(Mask mask, size_t position, size_t limit) { return search(mask, position, limit, 0); }
+    size_t findNot(Mask mask, size_t position, size_t limit) { return search(mask, position, limit, ~0ull); }
+
+    // Name of the block scanner in use: "avx2", "sse2" or "scalar"
+    static const char* implementation();
+
+    static constexpr size_t blockSize = 64;
+    static constexpr size_t windowBlocks = 64;
+
+private:
+    std::string_view source;
+    size_t windowStart = 1;  // Not a window boundary, so the first search loads one
+    size_t windowEnd = 0;
+    uint64_t masks[maskCount][windowBlocks];
+
+    void load(size_t position);
+
+    size_t search(Mask mask, size_t position, size_t limit, uint64_t invert) {
+        while (position < limit) {
+            if (position < windowStart || position >= windowEnd) load(position);
+            size_t block = (position - windowStart) / blockSize;
+            uint64_t bits = (masks[mask][block] ^ invert) & (~0ull << ((position - windowStart) % blockSize));
+            if (bits != 0) {
+                size_t found = windowStart + block * blockSize + __builtin_ctzll(bits);
+                return found < limit ? found : limit;
+            }
+            position = windowStart + (block + 1) * blockSize;
+        }
+        return limit;
+    }
+};
+
+#endif
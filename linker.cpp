@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <iostream>
+#include "linker.h"
+
+using namespace std;
+
+bool linkObjects(const vector<ObjectFile>& objects, const vector<string>& names, Program& program,
+                 SymbolTable& symbolTable, DataSegment& data, string& text, bool compress) {
+    program.clear();
+    symbolTable.clear();
+    data.clear();
+    text.clear();
+
+    size_t instructions = 0, textBytes = 0;
+    for (const ObjectFile& object : objects) {
+        instructions += object.program.size();
+        textBytes += object.text.size();
+    }
+    program.reserve(instructions);
+    text.reserve(textBytes);
+
+    // Lay out the sections and define every symbol. definedIn records the
+    // module defining each global, to report duplicates.
+    vector<TextLabel> textLabels;
+    vector<vector<SymbolId>> ids(objects.size());
+    vector<size_t> definedIn;
+    bool ok = true;
+    for (size_t m = 0; m < objects.size(); m++) {
+        const ObjectFile& object = objects[m];
+        size_t base = program.size();
+        uint32_t textBase = static_cast<uint32_t>(text.size());
+        data.align(object.dataAlignment);
+        uint32_t dataBase = data.address();
+        data.writeBytes(object.data.data(), object.data.size());
+        text.append(object.text);
+
+        ids[m].resize(object.symbols.size());
+        for (size_t s = 0; s < object.symbols.size(); s++) {
+            const ObjectSymbol& symbol = object.symbols[s];
+            uint32_t address = symbol.kind == SymbolKind::Data ? dataBase + symbol.value : 0;
+            SymbolId id;
+            if (symbol.kind != SymbolKind::Undefined && !symbol.global) {
+                id = symbolTable.addLocalLabel(symbol.name, address);
+            } else {
+                id = symbolTable.intern(symbol.name);
+                if (symbol.global) symbolTable.addGlobal(symbol.name);
+                if (definedIn.size() <= id) definedIn.resize(id + 1, objects.size());
+                if (symbol.kind != SymbolKind::Undefined) {
+                    if (definedIn[id] != objects.size()) {
+                        cerr << "Error: Symbol '" << symbol.name << "' is defined in both " << names[definedIn[id]]
+                             << " and " << names[m] << endl;
+                        ok = false;
+                    }
+                    definedIn[id] = m;
+                    symbolTable.addLabel(symbol.name, address);
+                }
+            }
+            if (symbol.kind == SymbolKind::Text) textLabels.push_back(TextLabel{id, static_cast<uint32_t>(base + symbol.value)});
+            ids[m][s] = id;
+        }
+
+        const Program& module = object.program;
+        program.resize(base + module.size());
+        for (size_t i = 0; i < module.size(); i++) {
+            program.ids[base + i] = module.ids[i];
+            program.rd[base + i] = module.rd[i];
+            program.rs1[base + i] = module.rs1[i];
+            program.rs2[base + i] = module.rs2[i];
+            program.immediates[base + i] = module.immediates[i];
+            program.symbols[base + i] = module.symbols[i] == noSymbolId ? noSymbolId : ids[m][module.symbols[i]];
+            program.modifiers[base + i] = module.modifiers[i];
+            program.sourceOffsets[base + i] = textBase + module.sourceOffsets[i];
+            program.sourceLengths[base + i] = module.sourceLengths[i];
+        }
+    }
+    if (!ok) return false;
+
+    // Every relocation must now name a label, local or global
+    size_t module = 0, moduleEnd = objects.empty() ? 0 : objects[0].program.size();
+    vector<uint8_t> reported(symbolTable.size(), 0);
+    for (size_t i = 0; i < program.size(); i++) {
+        while (i >= moduleEnd) moduleEnd += objects[++module].program.size();
+        SymbolId symbol = program.symbols[i];
+        if (symbol == noSymbolId || symbolTable.isLabel(symbol) || reported[symbol]) continue;
+        cerr << "Error: Undefined reference to '" << symbolTable.name(symbol) << "' in " << names[module] << endl;
+        reported[symbol] = 1;
+        ok = false;
+    }
+    if (!ok) return false;
+
+    // layoutText walks the labels in address order
+    stable_sort(textLabels.begin(), textLabels.end(),
+                [](const TextLabel& a, const TextLabel& b) { return a.index < b.index; });
+    program.setSource(text);
+    return layoutText(program, symbolTable, textLabels, compress);
+}
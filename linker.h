@@ -0,0 +1,18 @@
+#ifndef LINKER_H
+#define LINKER_H
+#include <string>
+#include <vector>
+#include "object_file.h"
+
+// Link objects into one program. Text and data are concatenated in order,
+// each module's data starting on its strictest alignment. Symbols a module
+// declares .globl, and symbols it uses without defining, are resolved by
+// name across all modules; other labels stay local to their module. The
+// linked program is then laid out by layoutText, which relaxes branches and
+// resolves every relocation. names are used in error messages; text
+// receives the statements of every module and backs program's source.
+// Undefined and multiply defined global symbols are reported to cerr.
+bool linkObjects(const std::vector<ObjectFile>& objects, const std::vector<std::string>& names, Program& program,
+                 SymbolTable& symbolTable, DataSegment& data, std::string& text, bool compress);
+
+#endif
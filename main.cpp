@@ -1,73 +1,323 @@
+#include <charconv>
 #include <cstdint>
-#include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
 #include <vector>
-#include <iomanip> // for hex formatting
-#include "parser.h"
-#include "converter.h"
-#include "symbol_table.h"
+#include "assembler.h"
+#include "disassembler.h"
+#include "encoder.h"
+#include "object_file.h"
+#include "parallel.h"
+#include "simulator.h"
+#include "verifier.h"
 
 using namespace std;
 
-string func(Instruction instr){
-    string s="";
-    s+=instr.opcode+'-'+instr.func3+'-'+instr.func7+'-'+instr.rd+'-'+instr.rs1+'-'+instr.rs2+'-'+instr.immediate;
-    return s;
+// The input name with its extension replaced
+static string replaceExtension(const string& input, const char* extension) {
+    size_t slash = input.find_last_of('/');
+    size_t dot = input.find_last_of('.');
+    string stem = (dot != string::npos && (slash == string::npos || dot > slash)) ? input.substr(0, dot) : input;
+    return stem + extension;
+}
+
+// Output path for a batch input
+static string batchOutputName(const string& input, OutputFormat format) {
+    if (format == OutputFormat::Binary) return replaceExtension(input, ".bin");
+    if (format == OutputFormat::Elf) return replaceExtension(input, ".elf");
+    return replaceExtension(input, ".mc");
 }
 
+// Parse a number argument, which must be all digits; a bad one ends up at
+// the usage message
+template <typename T>
+static bool parseCount(string_view text, T& value) {
+    auto result = from_chars(text.data(), text.data() + text.size(), value);
+    return !text.empty() && result.ec == errc() && result.ptr == text.data() + text.size();
+}
 
-int main() {
-    // Create a symbol table instance
-    SymbolTable symbolTable;
-    
-    // Vector to store parsed instructions
-    vector<Instruction> instructions;
+static bool isObjectName(const string& name) {
+    return name.size() > 2 && name.compare(name.size() - 2, 2, ".o") == 0;
+}
 
-    // Open input file
-    string inputFilename = "input.asm";
+// Read the .o inputs and assemble the others into objects, spread over up to
+// jobs threads with one assembler each; with writeObjects every assembled
+// object is also saved next to its source
+static bool loadModules(const vector<string>& inputs, vector<ObjectFile>& objects, unsigned jobs, bool writeObjects) {
+    objects.resize(inputs.size());
+    vector<uint8_t> failed(inputs.size(), 0);
+    parallelChunks(inputs.size(), jobs, 1, [&](size_t, size_t begin, size_t end) {
+        Assembler assembler;
+        for (size_t i = begin; i < end; i++) {
+            if (isObjectName(inputs[i])) {
+                failed[i] = !readObjectFile(inputs[i], objects[i]);
+                continue;
+            }
+            failed[i] = !assembler.assembleObject(inputs[i], objects[i]) ||
+                        (writeObjects && writeObjectFile(replaceExtension(inputs[i], ".o"), objects[i]) < 0);
+        }
+    });
+    bool ok = true;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (!failed[i]) continue;
+        cerr << "Error: Failed to assemble " << inputs[i] << endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// Read "input [output]" pairs from a manifest, one per line; '#' starts a comment
+static bool readManifest(const string& filename, vector<pair<string, string>>& jobsList, OutputFormat format) {
+    ifstream manifest(filename);
+    if (!manifest.is_open()) {
+        cerr << "Error: Could not open manifest " << filename << endl;
+        return false;
+    }
+    string line;
+    while (getline(manifest, line)) {
+        line = line.substr(0, line.find('#'));
+        string_view cursor = line;
+        string_view input, output;
+        if (!nextToken(cursor, input)) continue;
+        string inputName(input);
+        jobsList.emplace_back(inputName, nextToken(cursor, output) ? string(output) : batchOutputName(inputName, format));
+    }
+    return true;
+}
+
+// Print the --stats report, if one was requested
+static void printStats(const AssemblyStats* stats, bool json, ostream& out = cout) {
+    if (stats == nullptr) return;
+    if (json) stats->reportJson(out);
+    else stats->report(out);
+}
+
+// Run a loaded program and print the execution summary and final registers
+static int runSimulation(Simulator& simulator, uint64_t maxSteps) {
+    SimulationResult result = simulator.run(maxSteps);
+    cout << "Executed " << result.steps << " instructions in " << result.seconds << " s";
+    if (result.seconds > 0) cout << " (" << result.steps / result.seconds / 1e6 << " MIPS)";
+    cout << ", " << stopReasonName(result.reason);
+    if (result.reason != StopReason::Finished) cout << " at 0x" << hex << result.pc << dec;
+    cout << endl;
+    for (int r = 1; r < 32; r++) {
+        if (simulator.reg(r) != 0) cout << "x" << r << " = " << static_cast<int32_t>(simulator.reg(r)) << endl;
+    }
+    return result.reason == StopReason::Finished ? 0 : 1;
+}
+
+// Save the execution count of each text label's block from a profiled run,
+// for --reorder-blocks. Text labels are the ones below the data segment.
+static bool writeProfile(const string& filename, const SymbolTable& symbols, const Simulator& simulator) {
+    BlockProfile profile;
+    for (SymbolId id = 0; id < symbols.size(); id++) {
+        if (!symbols.isLabel(id) || symbols.address(id) >= DataSegment::baseAddress) continue;
+        profile.blocks[string(symbols.name(id))] = simulator.executions(symbols.address(id));
+    }
+    if (profile.save(filename) < 0) {
+        cerr << "Error: Could not write profile " << filename << endl;
+        return false;
+    }
+    return true;
+}
 
-    // Pass 1: Collect labels and directives
-    if (!parseFile(inputFilename, instructions, symbolTable, true)) {  // First pass (label collection)
-        cerr << "Error: Failed in Pass 1 (Label Collection)." << endl;
+// Print a listing's instruction words with their disassembly
+static int disassembleListing(const string& filename) {
+    vector<uint32_t> code;
+    vector<uint8_t> data;
+    if (!readTextListing(filename, code, data)) return 1;
+    uint32_t address = 0;
+    for (uint32_t word : code) {
+        cout << "0x" << hex << address << " 0x" << setw(isCompressedWord(word) ? 4 : 8) << setfill('0') << word
+             << dec << setfill(' ') << "  " << disassemble(word) << endl;
+        address += instructionLength(word);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // Annotated field breakdown is only produced with --annotate;
+    // --two-pass selects the original label pass + instruction pass parsing;
+    // --compress emits RV32C 16-bit forms wherever the operands fit;
+    // --cache file keeps parsed source blocks between runs and re-parses only changed ones;
+    // --pool-data merges duplicate .rodata objects and strings that end other ones;
+    // --reorder-blocks profile lays out hot paths as fall-throughs, using the
+    // block counts that --run --profile-out wrote on an earlier run;
+    // -c assembles each file argument into an object; --link links the file
+    // arguments (objects, or sources assembled on the fly) into one program.
+    // --stream assembles input of any length (typically "-i -") as it arrives.
+    // --format picks the .mc listing, raw binary images or an ELF file.
+    // Extra file arguments or --manifest assemble many inputs in one process.
+    Assembler assembler;
+    assembler.options.jobs = 0;           // Worker threads for encoding and formatting, 0 = all cores
+    bool annotate = false;
+    OutputFormat format = OutputFormat::Text;
+    string inputFilename = "input.asm";   // "-" reads the source from stdin
+    string outputFilename = "output.mc";
+    vector<string> batchInputs;
+    string manifestFilename;
+    AssemblyStats stats;
+    bool statsJson = false;
+    bool run = false;                     // Execute the assembled program after writing it
+    string runListing;                    // Execute an existing .mc listing instead of assembling
+    uint64_t maxSteps = 100000000;
+    bool verify = false;                  // Decode every emitted word and compare it with the source
+    size_t verifyRandom = 0;              // Round-trip this many random instructions instead of assembling
+    uint32_t seed = 1;
+    string disassembleFilename;
+    bool compileOnly = false;
+    bool link = false;
+    bool stream = false;
+    string profileOutput;                 // Write the block counts of the --run here
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--annotate") annotate = true;
+        else if (arg == "--two-pass") assembler.options.twoPass = true;
+        else if (arg == "--single-pass") assembler.options.twoPass = false;
+        else if (arg == "--compress") assembler.options.compress = true;
+        else if (arg == "--pool-data") assembler.options.poolData = true;
+        else if (arg == "--reorder-blocks" && i + 1 < argc) assembler.options.profileFile = argv[++i];
+        else if (arg == "--profile-out" && i + 1 < argc) profileOutput = argv[++i];
+        else if (arg == "--cache" && i + 1 < argc) assembler.options.cacheFile = argv[++i];
+        else if (arg == "-i" && i + 1 < argc) inputFilename = argv[++i];
+        else if (arg == "-o" && i + 1 < argc) outputFilename = argv[++i];
+        else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc && parseCount(argv[++i], assembler.options.jobs)) {
+            continue;
+        }
+        else if (arg == "--format" && i + 1 < argc && string(argv[i + 1]) == "mc") format = OutputFormat::Text, i++;
+        else if (arg == "--format" && i + 1 < argc && string(argv[i + 1]) == "bin") format = OutputFormat::Binary, i++;
+        else if (arg == "--format" && i + 1 < argc && string(argv[i + 1]) == "elf") format = OutputFormat::Elf, i++;
+        else if (arg == "--manifest" && i + 1 < argc) manifestFilename = argv[++i];
+        else if (arg == "--stats") assembler.options.stats = &stats;
+        else if (arg == "--stats=json") assembler.options.stats = &stats, statsJson = true;
+        else if (arg == "--run") run = true;
+        else if (arg == "--run-mc" && i + 1 < argc) runListing = argv[++i];
+        else if (arg == "--max-steps" && i + 1 < argc && parseCount(argv[++i], maxSteps)) continue;
+        else if (arg == "--verify") verify = true;
+        else if (arg == "--verify-random" && i + 1 < argc && parseCount(argv[++i], verifyRandom)) continue;
+        else if (arg == "--seed" && i + 1 < argc && parseCount(argv[++i], seed)) continue;
+        else if (arg == "--disassemble" && i + 1 < argc) disassembleFilename = argv[++i];
+        else if (arg == "-c") compileOnly = true;
+        else if (arg == "--link") link = true;
+        else if (arg == "--stream") stream = true;
+        else if (!arg.empty() && arg[0] != '-') batchInputs.push_back(arg);
+        else {
+            cerr << "Usage: " << argv[0] << " [-i input.asm|-] [-o output.mc] [--format mc|bin|elf] [--annotate] [-j jobs]"
+                 << " [--single-pass|--two-pass] [--compress] [--pool-data] [--reorder-blocks profile] [--cache file]"
+                 << " [--manifest list.txt] [--stats[=json]] [--run [--profile-out profile]] [--run-mc output.mc]"
+                 << " [--max-steps n] [--verify] [--verify-random n [--seed s]]"
+                 << " [--disassemble output.mc] [-c | --link | --stream] [file.asm|file.o...]" << endl;
+            return 1;
+        }
+    }
+
+    if (verifyRandom > 0) return verifyRandomInstructions(verifyRandom, seed, assembler.options.jobs) ? 0 : 1;
+    if (!disassembleFilename.empty()) return disassembleListing(disassembleFilename);
+    if (!runListing.empty()) {
+        Simulator simulator;
+        if (!simulator.loadListing(runListing)) return 1;
+        return runSimulation(simulator, maxSteps);
+    }
+
+    if (stream) {
+        // Nothing that needs the whole program applies; with -o - the
+        // listing goes to stdout, so messages go to stderr
+        if (assembler.options.compress || assembler.options.twoPass || assembler.options.poolData ||
+            !assembler.options.profileFile.empty() || !assembler.options.cacheFile.empty() || run || verify ||
+            compileOnly || link || !batchInputs.empty()) {
+            cerr << "Error: --stream cannot be combined with --compress, --two-pass, --pool-data, --reorder-blocks, "
+                 << "--cache, --run, --verify, -c, --link or several inputs" << endl;
+            return 1;
+        }
+        if (!assembler.assembleStream(inputFilename, outputFilename, format, annotate)) return 1;
+        ostream& out = outputFilename == "-" ? cerr : cout;
+        out << "Successfully converted " << inputFilename << " to " << outputFilename << " with directives!" << endl;
+        printStats(assembler.options.stats, statsJson, out);
+        return 0;
+    }
+
+    // Only the streaming writer can write to stdout
+    if (outputFilename == "-") {
+        cerr << "Error: -o - (standard output) needs --stream" << endl;
         return 1;
     }
-    
-    // Pass 2: Parse instructions again for final conversion
-    if (!parseFile(inputFilename, instructions, symbolTable, false)) {  // Second pass (actual conversion)
-        cerr << "Error: Failed in Pass 2 (Instruction Parsing)." << endl;
+    // Pooling and block reordering need the whole program at once
+    if ((assembler.options.poolData || !assembler.options.profileFile.empty()) &&
+        (!assembler.options.cacheFile.empty() || compileOnly || link)) {
+        cerr << "Error: --pool-data and --reorder-blocks cannot be combined with --cache, -c or --link" << endl;
         return 1;
     }
-
-    // Open output file
-    ofstream outFile("output.mc");
-    if (!outFile.is_open()) {
-        cerr << "Error: Could not open output file." << endl;
+    if (!profileOutput.empty() && !run) {
+        cerr << "Error: --profile-out needs --run" << endl;
         return 1;
     }
 
-    uint32_t address = 0x10000000; // Start of data segment
-    
-    // Write machine code for data section
-    int val = symbolTable.getData(address);
-    while(val!=-1) {
-        outFile << "0x" << hex << address++ << " 0x" << setfill('0') << setw(8) << val << " # Data" << endl;
-        val = symbolTable.getData(address);
+    if (compileOnly) {
+        if (batchInputs.empty()) batchInputs.push_back(inputFilename);
+        vector<ObjectFile> objects;
+        if (!loadModules(batchInputs, objects, assembler.options.jobs, true)) return 1;
+        cout << "Assembled " << objects.size() << " objects." << endl;
+        return 0;
     }
 
-    address = 0x0000000;
-    // Write machine code for instructions
-    for ( Instruction& instr : instructions) {
-        uint32_t machineCode = convertToMachineCode(instr, symbolTable);
-        string s=func(instr);
-        // Print and write to file in required format
-        outFile << "0x" << hex << address << " "
-                << "0x" << setfill('0') << setw(8) << machineCode << " , "<<instr.line_name<< " # "
-                << s << endl;
+    // Batch mode: one process, one assembler context reused for every file
+    if (!link && (!batchInputs.empty() || !manifestFilename.empty())) {
+        vector<pair<string, string>> jobsList;
+        for (const string& input : batchInputs) jobsList.emplace_back(input, batchOutputName(input, format));
+        if (!manifestFilename.empty() && !readManifest(manifestFilename, jobsList, format)) return 1;
+
+        size_t failed = 0;
+        size_t pooled = 0;
+        for (const auto& job : jobsList) {
+            if (!assembler.assembleFile(job.first) ||
+                (verify && verifyEncoding(assembler.program(), assembler.code(), assembler.options.jobs) != 0) ||
+                assembler.write(job.second, format, annotate) < 0) {
+                cerr << "Error: Failed to assemble " << job.first << endl;
+                failed++;
+                continue;
+            }
+            pooled += assembler.pooledBytes();
+        }
+        cout << "Assembled " << jobsList.size() - failed << " of " << jobsList.size() << " files." << endl;
+        if (assembler.options.poolData && failed < jobsList.size()) {
+            cout << "Pooled read-only data: " << pooled << " bytes saved." << endl;
+        }
+        printStats(assembler.options.stats, statsJson);
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (link) {
+        vector<ObjectFile> objects;
+        if (!loadModules(batchInputs, objects, assembler.options.jobs, false) || !assembler.link(objects, batchInputs)) {
+            return 1;
+        }
+        inputFilename = to_string(objects.size()) + " modules";
+    }
+    else if (!assembler.assembleFile(inputFilename)) return 1;
+    if (verify && verifyEncoding(assembler.program(), assembler.code(), assembler.options.jobs) != 0) {
+        cerr << "Error: Verification failed for " << inputFilename << endl;
+        return 1;
+    }
 
-        address += 4; // Increment address (each instruction is 4 bytes)
+    // Write the selected output format
+    if (assembler.write(outputFilename, format, annotate) < 0) {
+        cerr << "Error: Could not write output file " << outputFilename << endl;
+        return 1;
     }
 
-    cout << "Successfully converted input.asm to output.mc with directives!" << endl;
-    outFile.close();
+    cout << "Successfully converted " << inputFilename << " to " << outputFilename << " with directives!" << endl;
+    if (assembler.options.poolData) {
+        cout << "Pooled read-only data: " << assembler.pooledBytes() << " bytes saved." << endl;
+    }
+    printStats(assembler.options.stats, statsJson);
+    if (run) {
+        Simulator simulator;
+        simulator.load(assembler.code(), assembler.data().data(), assembler.data().size());
+        simulator.setProfiling(!profileOutput.empty());
+        int status = runSimulation(simulator, maxSteps);
+        if (!profileOutput.empty() && !writeProfile(profileOutput, assembler.symbols(), simulator)) return 1;
+        return status;
+    }
     return 0;
 }
@@ -0,0 +1,237 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "object_file.h"
+
+using namespace std;
+
+namespace {
+
+constexpr char objectMagic[8] = {'R', 'V', '3', '2', 'O', 'B', 'J', 0};
+constexpr uint32_t objectVersion = 2;
+constexpr size_t headerSize = 8 + 10 * 4;
+constexpr size_t instructionSize = 4 + 4 + 4 + 2;
+
+template <typename T>
+void putLE(vector<uint8_t>& out, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+}
+
+// Bounds-checked little-endian reader over a file image
+class Reader {
+public:
+    Reader(const vector<uint8_t>& bytes) : bytes(bytes) {}
+
+    template <typename T>
+    T get() {
+        uint64_t value = 0;
+        if (position + sizeof(T) > bytes.size()) {
+            ok = false;
+            return 0;
+        }
+        for (size_t i = 0; i < sizeof(T); i++) value |= static_cast<uint64_t>(bytes[position++]) << (8 * i);
+        return static_cast<T>(value);
+    }
+
+    const uint8_t* take(size_t count) {
+        if (count > bytes.size() - position) {
+            ok = false;
+            return nullptr;
+        }
+        position += count;
+        return bytes.data() + position - count;
+    }
+
+    bool ok = true;
+
+private:
+    const vector<uint8_t>& bytes;
+    size_t position = 0;
+};
+
+} // namespace
+
+void buildObject(const Program& program, const SymbolTable& symbolTable, const DataSegment& data,
+                 const vector<TextLabel>& textLabels, ObjectFile& object) {
+    object.program.clear();
+    object.text.clear();
+    object.symbols.clear();
+    object.program.resize(program.size());
+    object.program.ids = program.ids;
+    object.program.rd = program.rd;
+    object.program.rs1 = program.rs1;
+    object.program.rs2 = program.rs2;
+    object.program.immediates = program.immediates;
+    object.program.symbols = program.symbols;
+    object.program.modifiers = program.modifiers;
+
+    // Pseudo-instructions expand to several entries of one statement, which is stored once
+    for (size_t i = 0; i < program.size(); i++) {
+        if (i > 0 && program.sourceOffsets[i] == program.sourceOffsets[i - 1]) {
+            object.program.sourceOffsets[i] = object.program.sourceOffsets[i - 1];
+            object.program.sourceLengths[i] = object.program.sourceLengths[i - 1];
+            continue;
+        }
+        string_view statement = program.text(i);
+        object.program.sourceOffsets[i] = static_cast<uint32_t>(object.text.size());
+        object.program.sourceLengths[i] = static_cast<uint16_t>(statement.size());
+        object.text.append(statement.data(), statement.size());
+    }
+    object.data.assign(data.data(), data.data() + data.size());
+    object.dataAlignment = data.alignment();
+
+    // Symbols keep their ids. A label defined in .text gets its address from
+    // the layout, even if the name was also used for a data label.
+    object.symbols.resize(symbolTable.size());
+    for (SymbolId id = 0; id < symbolTable.size(); id++) {
+        ObjectSymbol& symbol = object.symbols[id];
+        symbol.name = string(symbolTable.name(id));
+        symbol.global = symbolTable.isGlobal(id);
+        if (symbolTable.isLabel(id)) {
+            symbol.kind = SymbolKind::Data;
+            symbol.value = symbolTable.address(id) - DataSegment::baseAddress;
+        }
+    }
+    for (const TextLabel& label : textLabels) {
+        object.symbols[label.symbol].kind = SymbolKind::Text;
+        object.symbols[label.symbol].value = label.index;
+    }
+}
+
+long long writeObjectFile(const string& filename, const ObjectFile& object) {
+    const Program& program = object.program;
+    size_t relocations = 0;
+    for (SymbolId symbol : program.symbols) relocations += symbol != noSymbolId;
+
+    vector<uint8_t> out;
+    out.reserve(headerSize + program.size() * instructionSize + relocations * 9 + object.text.size() +
+                object.data.size());
+    out.insert(out.end(), objectMagic, objectMagic + sizeof(objectMagic));
+    putLE<uint32_t>(out, objectVersion);
+    putLE<uint32_t>(out, static_cast<uint32_t>(instructionCount));
+    putLE<uint32_t>(out, mnemonicSeed);
+    putLE<uint32_t>(out, static_cast<uint32_t>(program.size()));
+    putLE<uint32_t>(out, static_cast<uint32_t>(object.symbols.size()));
+    putLE<uint32_t>(out, static_cast<uint32_t>(relocations));
+    putLE<uint32_t>(out, static_cast<uint32_t>(object.text.size()));
+    putLE<uint32_t>(out, static_cast<uint32_t>(object.data.size()));
+    putLE<uint32_t>(out, object.dataAlignment);
+    putLE<uint32_t>(out, 0);
+
+    for (size_t i = 0; i < program.size(); i++) {
+        out.push_back(program.ids[i]);
+        out.push_back(program.rd[i]);
+        out.push_back(program.rs1[i]);
+        out.push_back(program.rs2[i]);
+        putLE<int32_t>(out, program.immediates[i]);
+        putLE<uint32_t>(out, program.sourceOffsets[i]);
+        putLE<uint16_t>(out, program.sourceLengths[i]);
+    }
+    for (const ObjectSymbol& symbol : object.symbols) {
+        putLE<uint32_t>(out, static_cast<uint32_t>(symbol.name.size()));
+        out.push_back(static_cast<uint8_t>(symbol.kind));
+        out.push_back(symbol.global);
+        putLE<uint32_t>(out, symbol.value);
+        out.insert(out.end(), symbol.name.begin(), symbol.name.end());
+    }
+    for (size_t i = 0; i < program.size(); i++) {
+        if (program.symbols[i] == noSymbolId) continue;
+        putLE<uint32_t>(out, static_cast<uint32_t>(i));
+        putLE<uint32_t>(out, program.symbols[i]);
+        out.push_back(static_cast<uint8_t>(program.modifiers[i]));
+    }
+    out.insert(out.end(), object.text.begin(), object.text.end());
+    out.insert(out.end(), object.data.begin(), object.data.end());
+
+    ofstream file(filename, ios::binary);
+    if (!file.is_open()) return -1;
+    file.write(reinterpret_cast<const char*>(out.data()), out.size());
+    return file.good() ? static_cast<long long>(out.size()) : -1;
+}
+
+bool readObjectFile(const string& filename, ObjectFile& object) {
+    ifstream file(filename, ios::binary | ios::ate);
+    if (!file.is_open()) {
+        cerr << "Error: Could not open object file " << filename << endl;
+        return false;
+    }
+    vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+    Reader reader(bytes);
+    const uint8_t* magic = reader.take(sizeof(objectMagic));
+    uint32_t version = reader.get<uint32_t>();
+    uint32_t tableSize = reader.get<uint32_t>();
+    uint32_t tableSeed = reader.get<uint32_t>();
+    if (!file || !reader.ok || memcmp(magic, objectMagic, sizeof(objectMagic)) != 0) {
+        cerr << "Error: " << filename << " is not an object file" << endl;
+        return false;
+    }
+    if (version != objectVersion || tableSize != instructionCount || tableSeed != mnemonicSeed) {
+        cerr << "Error: " << filename << " was written by a different assembler version" << endl;
+        return false;
+    }
+    uint32_t instructions = reader.get<uint32_t>();
+    uint32_t symbols = reader.get<uint32_t>();
+    uint32_t relocations = reader.get<uint32_t>();
+    uint32_t textBytes = reader.get<uint32_t>();
+    uint32_t dataBytes = reader.get<uint32_t>();
+    object.dataAlignment = reader.get<uint32_t>();
+    reader.get<uint32_t>();
+    bool valid = reader.ok && bytes.size() / instructionSize >= instructions && bytes.size() / 10 >= symbols &&
+                 (object.dataAlignment & (object.dataAlignment - 1)) == 0;
+
+    Program& program = object.program;
+    program.clear();
+    if (valid) program.resize(instructions);
+    for (uint32_t i = 0; valid && i < instructions; i++) {
+        program.ids[i] = reader.get<uint8_t>();
+        program.rd[i] = reader.get<uint8_t>();
+        program.rs1[i] = reader.get<uint8_t>();
+        program.rs2[i] = reader.get<uint8_t>();
+        program.immediates[i] = reader.get<int32_t>();
+        program.sourceOffsets[i] = reader.get<uint32_t>();
+        program.sourceLengths[i] = reader.get<uint16_t>();
+        valid = program.ids[i] < instructionCount && program.rd[i] < 32 && program.rs1[i] < 32 &&
+                program.rs2[i] < 32 && program.sourceOffsets[i] + uint64_t(program.sourceLengths[i]) <= textBytes;
+    }
+
+    object.symbols.assign(valid ? symbols : 0, ObjectSymbol());
+    for (ObjectSymbol& symbol : object.symbols) {
+        uint32_t length = reader.get<uint32_t>();
+        uint8_t kind = reader.get<uint8_t>();
+        symbol.global = reader.get<uint8_t>() != 0;
+        symbol.value = reader.get<uint32_t>();
+        const uint8_t* name = reader.take(length);
+        if (!reader.ok || kind > static_cast<uint8_t>(SymbolKind::Data)) {
+            valid = false;
+            break;
+        }
+        symbol.kind = static_cast<SymbolKind>(kind);
+        symbol.name.assign(reinterpret_cast<const char*>(name), length);
+        if (symbol.kind == SymbolKind::Text && symbol.value > instructions) valid = false;
+        if (symbol.kind == SymbolKind::Data && symbol.value > dataBytes) valid = false;
+    }
+
+    for (uint32_t r = 0; valid && r < relocations; r++) {
+        uint32_t index = reader.get<uint32_t>();
+        uint32_t symbol = reader.get<uint32_t>();
+        uint8_t modifier = reader.get<uint8_t>();
+        valid = reader.ok && index < instructions && symbol < symbols &&
+                modifier <= static_cast<uint8_t>(Modifier::PcrelLo);
+        if (!valid) break;
+        program.symbols[index] = symbol;
+        program.modifiers[index] = static_cast<Modifier>(modifier);
+    }
+
+    const uint8_t* text = valid ? reader.take(textBytes) : nullptr;
+    const uint8_t* data = valid ? reader.take(dataBytes) : nullptr;
+    if (!valid || !reader.ok) {
+        cerr << "Error: Object file " << filename << " is damaged" << endl;
+        return false;
+    }
+    object.text.assign(reinterpret_cast<const char*>(text), textBytes);
+    object.data.assign(data, data + dataBytes);
+    return true;
+}
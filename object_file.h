@@ -0,0 +1,45 @@
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "program.h"
+#include "symbol_table.h"
+#include "data_segment.h"
+#include "relaxation.h"
+
+// Where a module defines a symbol
+enum class SymbolKind : uint8_t { Undefined, Text, Data };
+
+struct ObjectSymbol {
+    std::string name;
+    SymbolKind kind = SymbolKind::Undefined;
+    bool global = false; // Declared with .globl; undefined symbols are always looked up globally
+    uint32_t value = 0;  // Instruction index of a text label, offset into the module's data of a data label
+};
+
+// One separately assembled source file. Text is kept in its parsed form
+// before layout, so that the linker can relax and compress branches between
+// modules exactly as within one: every instruction that names a symbol is a
+// relocation (program.symbols indexes symbols, the immediate is the addend)
+// and is resolved only once the linked program has been laid out.
+struct ObjectFile {
+    Program program;                  // Source is not set; statement offsets index text
+    std::string text;                 // Source statements of the instructions, for listings
+    std::vector<uint8_t> data;
+    uint32_t dataAlignment = 1;       // The module's data must start on this boundary
+    std::vector<ObjectSymbol> symbols;
+};
+
+// Capture the result of parsing one file (before layoutText) as an object
+void buildObject(const Program& program, const SymbolTable& symbolTable, const DataSegment& data,
+                 const std::vector<TextLabel>& textLabels, ObjectFile& object);
+
+// Object files are little-endian: a header, the instructions, the symbols,
+// the relocations as (instruction, symbol, modifier) triples, the statement
+// text and the data bytes. write returns the bytes written or -1; read
+// reports problems to cerr.
+long long writeObjectFile(const std::string& filename, const ObjectFile& object);
+bool readObjectFile(const std::string& filename, ObjectFile& object);
+
+#endif
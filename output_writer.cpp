@@ -0,0 +1,380 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <bitset>
+#include <iostream>
+#include "output_writer.h"
+#include "parallel.h"
+#include "compressed.h"
+#include "encoder.h"
+
+using namespace std;
+
+// Build the "opcode-func3-func7-rd-rs1-rs2-imm" annotation from an encoded word.
+// Only called when the annotated listing is requested.
+string annotateFields(Format f, uint32_t machineCode){
+    const string null = "NULL";
+    string opcode = bitset<7>(machineCode).to_string();
+    string rd = bitset<5>(machineCode >> 7).to_string();
+    string func3 = bitset<3>(machineCode >> 12).to_string();
+    string rs1 = bitset<5>(machineCode >> 15).to_string();
+    string rs2 = bitset<5>(machineCode >> 20).to_string();
+    string func7 = bitset<7>(machineCode >> 25).to_string();
+    string imm = null;
+    if (f == Format::I) imm = bitset<12>(machineCode >> 20).to_string();
+    else if (f == Format::S) imm = bitset<12>(((machineCode >> 25) << 5) | ((machineCode >> 7) & 0x1F)).to_string();
+    else if (f == Format::SB) imm = bitset<13>(((machineCode >> 31) << 12) | (((machineCode >> 7) & 0x1) << 11) |
+                                         (((machineCode >> 25) & 0x3F) << 5) | (((machineCode >> 8) & 0xF) << 1)).to_string();
+    else if (f == Format::U) imm = bitset<20>(machineCode >> 12).to_string();
+    else if (f == Format::UJ) imm = bitset<21>(((machineCode >> 31) << 20) | (((machineCode >> 12) & 0xFF) << 12) |
+                                         (((machineCode >> 20) & 0x1) << 11) | (((machineCode >> 21) & 0x3FF) << 1)).to_string();
+
+    bool hasRd = f == Format::R || f == Format::I || f == Format::U || f == Format::UJ;
+    bool hasRs1 = f == Format::R || f == Format::I || f == Format::S || f == Format::SB;
+    bool hasRs2 = f == Format::R || f == Format::S || f == Format::SB;
+    bool hasFunc3 = hasRs1;
+    bool hasFunc7 = f == Format::R;
+    return opcode + '-' + (hasFunc3 ? func3 : null) + '-' + (hasFunc7 ? func7 : null) + '-' +
+           (hasRd ? rd : null) + '-' + (hasRs1 ? rs1 : null) + '-' + (hasRs2 ? rs2 : null) + '-' + imm;
+}
+
+
+// Append "0x" followed by value in lowercase hex, zero padded to minDigits
+static void appendHex(string& buffer, uint32_t value, int minDigits) {
+    static const char digits[] = "0123456789abcdef";
+    char text[10];
+    int count = 0;
+    do {
+        text[9 - count++] = digits[value & 0xF];
+        value >>= 4;
+    } while (value != 0 || count < minDigits);
+    buffer.append("0x", 2);
+    buffer.append(text + 10 - count, count);
+}
+
+void appendListingLine(string& buffer, uint32_t address, uint32_t word, Format format, string_view text,
+                       bool annotate) {
+    bool compressed = isCompressedWord(word);
+    appendHex(buffer, address, 1);
+    buffer.push_back(' ');
+    appendHex(buffer, word, compressed ? 4 : 8);
+    buffer.append(" , ", 3);
+    buffer.append(text.data(), text.size());
+    if (annotate) {
+        // RV32C words are annotated with the fields of the 32-bit instruction they stand for
+        buffer.append(" # ", 3);
+        buffer.append(annotateFields(format, compressed ? expandCompressed(static_cast<uint16_t>(word)) : word));
+    }
+    buffer.push_back('\n');
+}
+
+void appendDataLine(string& buffer, uint32_t address, uint8_t value) {
+    appendHex(buffer, address, 1);
+    buffer.push_back(' ');
+    appendHex(buffer, value, 8);
+    buffer.append(" # Data\n", 8);
+}
+
+// Format the listing lines of instructions [begin, end)
+static void formatInstructions(string& buffer, const Program& program, const vector<uint32_t>& code,
+                               size_t begin, size_t end, bool annotate) {
+    for (size_t i = begin; i < end; i++) {
+        appendListingLine(buffer, program.address(i), code[i], program.desc(i).format, program.text(i), annotate);
+    }
+}
+
+// Buffered writer: output is formatted into a large in-memory block and
+// handed to the stream in big chunks, never flushed per line
+class ChunkedWriter {
+private:
+    ofstream& out;
+    long long total = 0;
+
+public:
+    static constexpr size_t chunkSize = 1 << 20;
+    string buffer;
+
+    explicit ChunkedWriter(ofstream& out) : out(out) { buffer.reserve(chunkSize + 4096); }
+    ~ChunkedWriter() { flush(); }
+
+    void flush() {
+        out.write(buffer.data(), buffer.size());
+        total += buffer.size();
+        buffer.clear();
+    }
+    void maybeFlush() {
+        if (buffer.size() >= chunkSize) flush();
+    }
+    void write(const string& text) {
+        flush();
+        out.write(text.data(), text.size());
+        total += text.size();
+    }
+
+    long long bytesWritten() {
+        flush();
+        return total;
+    }
+};
+
+long long writeTextOutput(const string& filename, const Program& program, const vector<uint32_t>& code,
+                          const DataSegment& data, bool annotate, unsigned jobs) {
+    ofstream outFile(filename, ios::binary);
+    if (!outFile.is_open()) return -1;
+
+    ChunkedWriter writer(outFile);
+
+    // Data section, one line per byte
+    uint32_t address = DataSegment::baseAddress;
+    const uint8_t* bytes = data.data();
+    for (size_t i = 0; i < data.size(); i++) {
+        appendDataLine(writer.buffer, address++, bytes[i]);
+        writer.maybeFlush();
+    }
+    writer.flush();
+
+    // Instructions, formatted in batches: each worker formats a contiguous
+    // slice into its own buffer and the slices are written back in order
+    const size_t linesPerChunk = 1 << 16;
+    size_t chunks = parallelChunkCount(code.size(), jobs, linesPerChunk);
+    vector<string> parts(chunks);
+    for (size_t batchBegin = 0; batchBegin < code.size(); batchBegin += chunks * linesPerChunk) {
+        size_t batchEnd = min(code.size(), batchBegin + chunks * linesPerChunk);
+        parallelChunks(batchEnd - batchBegin, jobs, linesPerChunk, [&](size_t chunk, size_t begin, size_t end) {
+            parts[chunk].clear();
+            formatInstructions(parts[chunk], program, code, batchBegin + begin, batchBegin + end, annotate);
+        });
+        for (const string& part : parts) {
+            writer.write(part);
+        }
+        for (string& part : parts) part.clear();
+    }
+
+    long long total = writer.bytesWritten();
+    return outFile.good() ? total : -1;
+}
+
+// Read a listing back: data bytes at or above the data base address,
+// instruction words below it, which must be contiguous (2 or 4 bytes each).
+// Annotations after the value are ignored.
+bool readTextListing(const string& filename, vector<uint32_t>& code, vector<uint8_t>& data) {
+    ifstream listing(filename);
+    if (!listing.is_open()) {
+        cerr << "Error: Could not open listing " << filename << endl;
+        return false;
+    }
+    code.clear();
+    data.clear();
+    string line;
+    size_t lineNumber = 0;
+    uint32_t textAddress = 0;
+    while (getline(listing, line)) {
+        lineNumber++;
+        if (line.empty()) continue;
+        char* end = nullptr;
+        unsigned long address = strtoul(line.c_str(), &end, 16);
+        char* valueEnd = nullptr;
+        unsigned long value = strtoul(end, &valueEnd, 16);
+        if (end == line.c_str() || valueEnd == end) {
+            cerr << "Error: Malformed listing line " << lineNumber << " in " << filename << endl;
+            return false;
+        }
+        if (address >= DataSegment::baseAddress) {
+            size_t offset = address - DataSegment::baseAddress;
+            if (offset >= data.size()) data.resize(offset + 1, 0);
+            data[offset] = static_cast<uint8_t>(value);
+        } else {
+            if (address != textAddress) {
+                cerr << "Error: Unexpected instruction address on line " << lineNumber << " in " << filename << endl;
+                return false;
+            }
+            code.push_back(static_cast<uint32_t>(value));
+            textAddress += instructionLength(code.back());
+        }
+    }
+    return true;
+}
+
+// Write a value to a byte buffer in little-endian order
+template <typename T>
+static void putLE(vector<uint8_t>& out, T value) {
+    for (size_t i = 0; i < sizeof(T); i++) out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+}
+
+// Instruction words at their encoded length: 2 bytes for RV32C, 4 otherwise
+static void putWords(vector<uint8_t>& out, const vector<uint32_t>& code) {
+    for (uint32_t word : code) {
+        if (isCompressedWord(word)) putLE(out, static_cast<uint16_t>(word));
+        else putLE(out, word);
+    }
+}
+
+static size_t textBytes(const vector<uint32_t>& code) {
+    size_t total = 0;
+    for (uint32_t word : code) total += instructionLength(word);
+    return total;
+}
+
+static bool writeFile(const string& filename, const vector<uint8_t>& bytes) {
+    ofstream outFile(filename, ios::binary);
+    if (!outFile.is_open()) return false;
+    outFile.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    return outFile.good();
+}
+
+long long writeBinaryOutput(const string& filename, const vector<uint32_t>& code, const DataSegment& data) {
+    vector<uint8_t> text;
+    text.reserve(textBytes(code));
+    putWords(text, code);
+    vector<uint8_t> dataImage(data.data(), data.data() + data.size());
+
+    if (!writeFile(filename, text) || !writeFile(filename + ".data", dataImage)) return -1;
+    return static_cast<long long>(text.size() + dataImage.size());
+}
+
+// ELF32 constants used by the writer
+namespace elf {
+constexpr uint16_t typeExec = 2;
+constexpr uint16_t machineRiscv = 243;
+constexpr uint32_t flagRvc = 1; // EF_RISCV_RVC: the text contains compressed instructions
+constexpr uint32_t sectionProgbits = 1, sectionSymtab = 2, sectionStrtab = 3;
+constexpr uint32_t flagWrite = 1, flagAlloc = 2, flagExec = 4;
+constexpr uint32_t segmentLoad = 1;
+constexpr uint32_t permExec = 1, permWrite = 2, permRead = 4;
+constexpr size_t headerSize = 52, programHeaderSize = 32, sectionHeaderSize = 40, symbolSize = 16;
+constexpr uint32_t pageSize = 0x1000;
+constexpr uint8_t bindLocal = 0, bindGlobal = 1, typeNotype = 0;
+}
+
+static void padTo(vector<uint8_t>& out, size_t offset) {
+    if (out.size() < offset) out.resize(offset, 0);
+}
+
+static uint32_t addString(string& table, string_view name) {
+    uint32_t offset = static_cast<uint32_t>(table.size());
+    table.append(name.data(), name.size());
+    table.push_back('\0');
+    return offset;
+}
+
+long long writeElfOutput(const string& filename, const vector<uint32_t>& code, const DataSegment& data,
+                         const SymbolTable& symbolTable) {
+    // Section indices
+    enum { shNull, shText, shData, shSymtab, shStrtab, shShstrtab, shCount };
+
+    // Symbol table: locals must precede globals
+    string strtab(1, '\0');
+    vector<uint8_t> symtab(elf::symbolSize, 0); // Entry 0 is the null symbol
+    uint32_t firstGlobal = 1;
+    for (int pass = 0; pass < 2; pass++) {
+        for (SymbolId id = 0; id < symbolTable.size(); id++) {
+            bool global = symbolTable.isGlobal(id);
+            if (!symbolTable.isLabel(id) || global != (pass == 1)) continue;
+            uint32_t address = symbolTable.address(id);
+            uint16_t section = address >= DataSegment::baseAddress ? shData : shText;
+            putLE<uint32_t>(symtab, addString(strtab, symbolTable.name(id)));
+            putLE<uint32_t>(symtab, address);
+            putLE<uint32_t>(symtab, 0);
+            symtab.push_back(static_cast<uint8_t>(((global ? elf::bindGlobal : elf::bindLocal) << 4) | elf::typeNotype));
+            symtab.push_back(0);
+            putLE<uint16_t>(symtab, section);
+        }
+        if (pass == 0) firstGlobal = static_cast<uint32_t>(symtab.size() / elf::symbolSize);
+    }
+
+    string shstrtab(1, '\0');
+    uint32_t nameText = addString(shstrtab, ".text");
+    uint32_t nameData = addString(shstrtab, ".data");
+    uint32_t nameSymtab = addString(shstrtab, ".symtab");
+    uint32_t nameStrtab = addString(shstrtab, ".strtab");
+    uint32_t nameShstrtab = addString(shstrtab, ".shstrtab");
+
+    // File layout: headers, then each loadable segment on its own page so the
+    // file can be mapped directly, then the non-loaded tables
+    uint16_t programHeaders = data.size() > 0 ? 2 : 1;
+    size_t textOffset = elf::pageSize;
+    size_t textSize = textBytes(code);
+    bool compressed = textSize != code.size() * 4;
+    size_t dataOffset = (textOffset + textSize + elf::pageSize - 1) & ~size_t(elf::pageSize - 1);
+    size_t symtabOffset = (dataOffset + data.size() + 3) & ~size_t(3);
+    size_t strtabOffset = symtabOffset + symtab.size();
+    size_t shstrtabOffset = strtabOffset + strtab.size();
+    size_t sectionHeadersOffset = (shstrtabOffset + shstrtab.size() + 3) & ~size_t(3);
+
+    uint32_t entry = symbolTable.getAddress("_start");
+    if (entry == 0xFFFFFFFF) entry = symbolTable.getAddress("main");
+    if (entry == 0xFFFFFFFF) entry = 0;
+
+    vector<uint8_t> out;
+    out.reserve(sectionHeadersOffset + shCount * elf::sectionHeaderSize);
+
+    // ELF header
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1 /* 32-bit */, 1 /* little-endian */, 1 /* version */};
+    out.insert(out.end(), ident, ident + 16);
+    putLE<uint16_t>(out, elf::typeExec);
+    putLE<uint16_t>(out, elf::machineRiscv);
+    putLE<uint32_t>(out, 1);                        // e_version
+    putLE<uint32_t>(out, entry);                    // e_entry
+    putLE<uint32_t>(out, elf::headerSize);          // e_phoff
+    putLE<uint32_t>(out, static_cast<uint32_t>(sectionHeadersOffset));
+    putLE<uint32_t>(out, compressed ? elf::flagRvc : 0); // e_flags
+    putLE<uint16_t>(out, elf::headerSize);
+    putLE<uint16_t>(out, elf::programHeaderSize);
+    putLE<uint16_t>(out, programHeaders);
+    putLE<uint16_t>(out, elf::sectionHeaderSize);
+    putLE<uint16_t>(out, shCount);
+    putLE<uint16_t>(out, shShstrtab);
+
+    // Program headers
+    auto programHeader = [&](size_t offset, uint32_t address, size_t size, uint32_t flags) {
+        putLE<uint32_t>(out, elf::segmentLoad);
+        putLE<uint32_t>(out, static_cast<uint32_t>(offset));
+        putLE<uint32_t>(out, address); // p_vaddr
+        putLE<uint32_t>(out, address); // p_paddr
+        putLE<uint32_t>(out, static_cast<uint32_t>(size));
+        putLE<uint32_t>(out, static_cast<uint32_t>(size));
+        putLE<uint32_t>(out, flags);
+        putLE<uint32_t>(out, elf::pageSize);
+    };
+    programHeader(textOffset, 0, textSize, elf::permRead | elf::permExec);
+    if (data.size() > 0) {
+        programHeader(dataOffset, DataSegment::baseAddress, data.size(), elf::permRead | elf::permWrite);
+    }
+
+    // Section contents
+    padTo(out, textOffset);
+    putWords(out, code);
+    padTo(out, dataOffset);
+    out.insert(out.end(), data.data(), data.data() + data.size());
+    padTo(out, symtabOffset);
+    out.insert(out.end(), symtab.begin(), symtab.end());
+    out.insert(out.end(), strtab.begin(), strtab.end());
+    out.insert(out.end(), shstrtab.begin(), shstrtab.end());
+    padTo(out, sectionHeadersOffset);
+
+    // Section headers
+    auto sectionHeader = [&](uint32_t name, uint32_t type, uint32_t flags, uint32_t address, size_t offset,
+                             size_t size, uint32_t link, uint32_t info, uint32_t align, uint32_t entrySize) {
+        putLE<uint32_t>(out, name);
+        putLE<uint32_t>(out, type);
+        putLE<uint32_t>(out, flags);
+        putLE<uint32_t>(out, address);
+        putLE<uint32_t>(out, static_cast<uint32_t>(offset));
+        putLE<uint32_t>(out, static_cast<uint32_t>(size));
+        putLE<uint32_t>(out, link);
+        putLE<uint32_t>(out, info);
+        putLE<uint32_t>(out, align);
+        putLE<uint32_t>(out, entrySize);
+    };
+    sectionHeader(0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    sectionHeader(nameText, elf::sectionProgbits, elf::flagAlloc | elf::flagExec, 0, textOffset, textSize, 0, 0, 4, 0);
+    sectionHeader(nameData, elf::sectionProgbits, elf::flagAlloc | elf::flagWrite, DataSegment::baseAddress,
+                  dataOffset, data.size(), 0, 0, 1, 0);
+    sectionHeader(nameSymtab, elf::sectionSymtab, 0, 0, symtabOffset, symtab.size(), shStrtab, firstGlobal, 4,
+                  elf::symbolSize);
+    sectionHeader(nameStrtab, elf::sectionStrtab, 0, 0, strtabOffset, strtab.size(), 0, 0, 1, 0);
+    sectionHeader(nameShstrtab, elf::sectionStrtab, 0, 0, shstrtabOffset, shstrtab.size(), 0, 0, 1, 0);
+
+    if (!writeFile(filename, out)) return -1;
+    return static_cast<long long>(out.size());
+}
@@ -0,0 +1,41 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "program.h"
+#include "data_segment.h"
+#include "symbol_table.h"
+
+// Output backends for an assembled program. code holds one encoded word per
+// instruction of program. Each writer returns the number of bytes written,
+// or -1 if a file could not be written.
+enum class OutputFormat { Text, Binary, Elf };
+
+// Annotated .mc listing: data bytes first, then one line per instruction.
+// Instruction lines are formatted on up to jobs threads (0 = all cores).
+long long writeTextOutput(const std::string& filename, const Program& program, const std::vector<uint32_t>& code,
+                          const DataSegment& data, bool annotate, unsigned jobs);
+
+// Append one line of a listing: an instruction word with its statement (and
+// field breakdown when annotating), or one data byte
+void appendListingLine(std::string& buffer, uint32_t address, uint32_t word, Format format, std::string_view text,
+                       bool annotate);
+void appendDataLine(std::string& buffer, uint32_t address, uint8_t value);
+
+// Parse a listing written by writeTextOutput back into the text words and
+// the data image; errors are reported to cerr
+bool readTextListing(const std::string& filename, std::vector<uint32_t>& code, std::vector<uint8_t>& data);
+
+// Raw little-endian images: text segment to filename, data segment to filename + ".data"
+long long writeBinaryOutput(const std::string& filename, const std::vector<uint32_t>& code, const DataSegment& data);
+
+// RV32 ELF executable with .text at 0, .data at DataSegment::baseAddress and a symbol table
+long long writeElfOutput(const std::string& filename, const std::vector<uint32_t>& code, const DataSegment& data,
+                         const SymbolTable& symbolTable);
+
+// The "opcode-func3-func7-rd-rs1-rs2-imm" field breakdown of an encoded word
+std::string annotateFields(Format format, uint32_t machineCode);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use when the caller asks for "all cores" (0)
+inline unsigned resolveJobCount(unsigned jobs) {
+    if (jobs != 0) return jobs;
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores == 0 ? 1 : cores;
+}
+
+// Number of chunks parallelChunks uses: at most jobs, each of at least minChunk items
+inline size_t parallelChunkCount(size_t count, unsigned jobs, size_t minChunk) {
+    size_t chunks = std::min<size_t>(resolveJobCount(jobs), (count + minChunk - 1) / std::max<size_t>(minChunk, 1));
+    return chunks == 0 ? 1 : chunks;
+}
+
+// Split [0, count) into parallelChunkCount contiguous chunks and run
+// body(chunk, begin, end) for each chunk, one chunk per thread. The calling
+// thread takes the first chunk; small inputs run inline.
+template <typename Body>
+void parallelChunks(size_t count, unsigned jobs, size_t minChunk, Body body) {
+    size_t chunks = parallelChunkCount(count, jobs, minChunk);
+    if (chunks == 1) {
+        body(size_t(0), size_t(0), count);
+        return;
+    }
+
+    size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    for (size_t chunk = 1; chunk < chunks; chunk++) {
+        size_t begin = std::min(count, chunk * chunkSize);
+        size_t end = std::min(count, begin + chunkSize);
+        workers.emplace_back([=, &body] { body(chunk, begin, end); });
+    }
+    body(size_t(0), size_t(0), std::min(count, chunkSize));
+    for (std::thread& worker : workers) worker.join();
+}
+
+#endif
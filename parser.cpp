@@ -1,258 +1,882 @@
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <string>
-#include <algorithm>
+#include <string_view>
+#include <charconv>
 #include <cstdint>
+#include <climits>
 #include "parser.h"
+#include "lexer.h"
 #include "symbol_table.h"
-#include "converter.h"
+#include "relaxation.h"
+#include "data_pool.h"
+#include "block_order.h"
+#include "expression.h"
+#include "encoder.h"
+#include "debug_log.h"
+#include "parallel.h"
 
 using namespace std;
 
-// Helper function to trim whitespace from a string
-string trimWhitespace(const string& str) {
-    size_t first = str.find_first_not_of(" \t");
-    if (first == string::npos) return "";
-    size_t last = str.find_last_not_of(" \t");
-    return str.substr(first, last - first + 1);
+// ABI names of x0-x31 by index; fp is a second name for s0
+static constexpr string_view abiRegisterNames[32] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
+    "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"};
+
+// Helper function to parse a register name to its index ("x1" or "ra" -> 1)
+static bool parseRegister(string_view text, uint8_t& index) {
+    if (text.size() >= 2 && text[0] == 'x' && isdigit(static_cast<unsigned char>(text[1]))) {
+        unsigned value = 0;
+        auto result = from_chars(text.data() + 1, text.data() + text.size(), value);
+        if (result.ec != errc() || result.ptr != text.data() + text.size() || value > 31) return false;
+        index = static_cast<uint8_t>(value);
+        return true;
+    }
+    if (text == "fp") {
+        index = 8;
+        return true;
+    }
+    for (uint8_t i = 0; i < 32; i++) {
+        if (abiRegisterNames[i] == text) {
+            index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Value of an operand that must be constant, such as a directive operand
+static bool parseConstant(string_view text, SymbolTable& symbolTable, int64_t& value) {
+    Expression expression;
+    if (!evaluateExpression(text, symbolTable, expression) || !expression.isConstant()) return false;
+    value = expression.value;
+    return true;
+}
+
+// A constant that needs more than 32 signed bits fits no instruction field.
+// Saturating it, instead of letting it wrap, keeps it out of range for
+// checkImmediates.
+static int32_t narrowConstant(int64_t value) {
+    return value < INT32_MIN ? INT32_MIN : value > INT32_MAX ? INT32_MAX : static_cast<int32_t>(value);
+}
+
+// Helper function to parse li's constant, which may also be spelled as an
+// unsigned 32-bit value
+static bool parseImmediate(string_view text, SymbolTable& symbolTable, int32_t& immediate) {
+    int64_t value;
+    if (!parseConstant(text, symbolTable, value) || value < INT32_MIN || value > UINT32_MAX) return false;
+    immediate = static_cast<int32_t>(value);
+    return true;
 }
 
-// Helper function to remove comments (anything after #)
-string removeComments(const string& str) {
-    size_t commentPos = str.find('#');
-    if (commentPos != string::npos) {
-        return str.substr(0, commentPos);
+// Label (plus a constant addend) or literal byte offset of a branch/jump
+// operand; labels are resolved later by layoutText
+static bool parseTarget(string_view operand, SymbolTable& symbolTable, int32_t& immediate, SymbolId& symbol) {
+    Expression target;
+    if (!evaluateExpression(operand, symbolTable, target) || target.modifier != Modifier::None) return false;
+    if (target.isConstant()) {
+        immediate = narrowConstant(target.value);
+    } else if (target.value >= INT32_MIN && target.value <= UINT32_MAX) {
+        immediate = static_cast<int32_t>(target.value);
+    } else {
+        return false;
     }
-    return str;
+    symbol = target.symbol;
+    return true;
 }
 
-string decimalToHex(int decimal) {
-    stringstream ss;
-    ss << hex << decimal;  
-    return ss.str();
+// Number of source operands each operand shape expects
+static int operandCount(OperandShape shape) {
+    switch (shape) {
+        case OperandShape::RegRegReg:
+        case OperandShape::RegRegImm:
+        case OperandShape::RegRegLabel:
+            return 3;
+        default:
+            return 2;
+    }
 }
 
-// Function to parse instructions
-void parseInstructionFields(const string& line,string& line_name, string& opcode, string& format, string& rd, string& rs1, string& rs2, string& immediate) {
-    line_name=line;
-    istringstream iss(line);
-    iss >> opcode;  // Read the opcode first
-
-    // Identify instruction format while parsing
-    if (opcode == "add" || opcode == "sub" || opcode == "xor" || 
-        opcode == "or" || opcode == "and" || opcode == "sll" || 
-        opcode == "slt" || opcode == "sra" || opcode == "srl" || 
-        opcode == "mul" || opcode == "div" || opcode == "rem") {
-        
-        format = "R"; // R-format
-        iss >> rd >> rs1 >> rs2;
-        if (!rd.empty() && rd.back() == ',') rd.pop_back();
-        if (!rs1.empty() && rs1.back() == ',') rs1.pop_back();
-        if (!rs2.empty() && rs2.back() == ',') rs2.pop_back();
-    } 
-    else if (opcode == "addi" || opcode == "andi" || opcode == "ori") {
-        format = "I"; // I-format
-        iss >> rd >> rs1 >> immediate; 
-        if (!rd.empty() && rd.back() == ',') rd.pop_back();
-        if (!rs1.empty() && rs1.back() == ',') rs1.pop_back();
-    } 
-    else if (opcode == "lb" || opcode == "lh" || opcode == "lw" || opcode == "ld" || opcode == "jalr") {
-        format = "I"; // I-format for load instructions
-        string rdStr, addressStr;
-        iss >> rdStr >> addressStr;
-        if (!rdStr.empty() && rdStr.back() == ',') rdStr.pop_back();
-
-        size_t openBracket = addressStr.find('(');
-        size_t closeBracket = addressStr.find(')');
-
-        if (openBracket != string::npos && closeBracket != string::npos) {
-            immediate = addressStr.substr(0, openBracket);
-            rs1 = addressStr.substr(openBracket + 1, closeBracket - openBracket - 1);
-        }
-        rd = rdStr;
+// Pseudo-instructions, expanded to base instructions while parsing
+enum class Pseudo : uint8_t {
+    Nop, Mv, Neg, Li, La, J, Jal, Jr, Jalr, Ret, Call, Tail,
+    Beqz, Bnez, Blez, Bgez, Bltz, Bgtz, Bgt, Ble, Sltz, Sgtz
+};
+
+struct PseudoDesc {
+    string_view mnemonic;
+    Pseudo kind;
+    uint8_t operands;
+    uint8_t length; // Base instructions emitted before relaxation, 0 = depends on the value (li)
+};
+
+// jal and jalr also have one-operand forms that link through x1
+static constexpr PseudoDesc pseudoTable[] = {
+    {"nop", Pseudo::Nop, 0, 1},   // addi x0, x0, 0
+    {"mv", Pseudo::Mv, 2, 1},     // addi rd, rs, 0
+    {"neg", Pseudo::Neg, 2, 1},   // sub rd, x0, rs
+    {"li", Pseudo::Li, 2, 0},     // addi rd, x0, imm | lui rd, hi [+ addi rd, rd, lo]
+    {"la", Pseudo::La, 2, 2},     // auipc rd, hi; addi rd, rd, lo
+    {"j", Pseudo::J, 1, 1},       // jal x0, label
+    {"jal", Pseudo::Jal, 1, 1},   // jal x1, label
+    {"jr", Pseudo::Jr, 1, 1},     // jalr x0, 0(rs)
+    {"jalr", Pseudo::Jalr, 1, 1}, // jalr x1, 0(rs)
+    {"ret", Pseudo::Ret, 0, 1},   // jalr x0, 0(x1)
+    {"call", Pseudo::Call, 1, 1}, // jal x1, label, relaxed to auipc x1 + jalr x1 when far
+    {"tail", Pseudo::Tail, 1, 1}, // jal x0, label, relaxed to auipc x6 + jalr x0 when far
+    {"beqz", Pseudo::Beqz, 2, 1}, // beq rs, x0, label
+    {"bnez", Pseudo::Bnez, 2, 1}, // bne rs, x0, label
+    {"blez", Pseudo::Blez, 2, 1}, // bge x0, rs, label
+    {"bgez", Pseudo::Bgez, 2, 1}, // bge rs, x0, label
+    {"bltz", Pseudo::Bltz, 2, 1}, // blt rs, x0, label
+    {"bgtz", Pseudo::Bgtz, 2, 1}, // blt x0, rs, label
+    {"bgt", Pseudo::Bgt, 3, 1},   // blt rt, rs, label
+    {"ble", Pseudo::Ble, 3, 1},   // bge rt, rs, label
+    {"sltz", Pseudo::Sltz, 2, 1}, // slt rd, rs, x0
+    {"sgtz", Pseudo::Sgtz, 2, 1}, // slt rd, x0, rs
+};
+
+static const PseudoDesc* findPseudo(string_view mnemonic, int operands) {
+    for (const PseudoDesc& desc : pseudoTable) {
+        if (desc.mnemonic == mnemonic && desc.operands == operands) return &desc;
     }
-    else if (opcode == "sb" || opcode == "sh" || opcode == "sw" || opcode == "sd") {
-        format = "S"; // S-format
-        string rs2Str, addressStr;
-        iss >> rs2Str >> addressStr;
-        if (!rs2Str.empty() && rs2Str.back() == ',') rs2Str.pop_back();
+    return nullptr;
+}
 
-        size_t openBracket = addressStr.find('(');
-        size_t closeBracket = addressStr.find(')');
+static constexpr uint8_t idSub = instructionId("sub");
+static constexpr uint8_t idSlt = instructionId("slt");
+static constexpr uint8_t idAddi = instructionId("addi");
+static constexpr uint8_t idLui = instructionId("lui");
+static constexpr uint8_t idAuipc = instructionId("auipc");
+static constexpr uint8_t idJal = instructionId("jal");
+static constexpr uint8_t idJalr = instructionId("jalr");
+static constexpr uint8_t idBeq = instructionId("beq");
+static constexpr uint8_t idBne = instructionId("bne");
+static constexpr uint8_t idBlt = instructionId("blt");
+static constexpr uint8_t idBge = instructionId("bge");
+
+// Immediate operand of an I-, S- or U-format instruction: a constant, or a
+// label under the modifier naming the part of its address the instruction
+// takes. lui takes %hi, auipc %pcrel_hi; the others take %lo, or
+// %pcrel_lo, which must directly follow an auipc of the same label.
+// layoutText resolves the label, with the constant as addend.
+static bool parseImmediateOperand(string_view text, SymbolTable& symbolTable, uint8_t id, int32_t& immediate,
+                                  SymbolId& symbol, Modifier& modifier) {
+    Expression value;
+    if (!evaluateExpression(text, symbolTable, value)) return false;
+    if (value.isConstant()) {
+        immediate = narrowConstant(value.value);
+    } else {
+        if (value.value < INT32_MIN || value.value > UINT32_MAX) return false;
+        bool accepted = id == idLui     ? value.modifier == Modifier::Hi
+                        : id == idAuipc ? value.modifier == Modifier::PcrelHi
+                                        : value.modifier == Modifier::Lo || value.modifier == Modifier::PcrelLo;
+        if (!accepted) return false;
+        immediate = static_cast<int32_t>(value.value);
+        modifier = value.modifier;
+    }
+    symbol = value.symbol;
+    return true;
+}
+
+// Split "offset(reg)" into its offset and base register. The register is
+// the last parenthesized group, so the offset may use parentheses itself,
+// as in %lo(label)(x5).
+static bool parseMemoryOperand(string_view addressStr, SymbolTable& symbolTable, uint8_t id, int32_t& immediate,
+                               SymbolId& symbol, Modifier& modifier, uint8_t& reg) {
+    size_t openBracket = addressStr.rfind('(');
+    if (openBracket == string_view::npos || addressStr.back() != ')') return false;
+    string_view offset = addressStr.substr(0, openBracket);
+    immediate = 0;
+    if (offset.find_first_not_of(" \t") != string_view::npos &&
+        !parseImmediateOperand(offset, symbolTable, id, immediate, symbol, modifier)) {
+        return false;
+    }
+    return parseRegister(addressStr.substr(openBracket + 1, addressStr.size() - openBracket - 2), reg);
+}
 
-        if (openBracket != string::npos && closeBracket != string::npos) {
-            immediate = addressStr.substr(0, openBracket);
-            rs1 = addressStr.substr(openBracket + 1, closeBracket - openBracket - 1);
+// Split li's value into lui's 20-bit field and the sign-extended low 12 bits
+static void splitImmediate(int32_t value, int32_t& upper, int32_t& lower) {
+    lower = signExtend(static_cast<uint32_t>(value) & 0xFFF, 12);
+    upper = static_cast<int32_t>((static_cast<uint32_t>(value) - static_cast<uint32_t>(lower)) >> 12);
+}
+
+static size_t liLength(int32_t value) {
+    if (value >= -2048 && value <= 2047) return 1;
+    int32_t upper, lower;
+    splitImmediate(value, upper, lower);
+    return lower == 0 ? 1 : 2;
+}
+
+// Emit the base instructions for a pseudo-instruction; false on bad operands
+static bool expandPseudoInstruction(const PseudoDesc& pseudo, const SourceLine& line, Program& program,
+                                    SymbolTable& symbolTable) {
+    const string_view* operands = line.operands;
+    uint8_t rd = 0, rs = 0, rt = 0;
+    int32_t immediate = 0;
+    SymbolId symbol = noSymbolId;
+    auto emit = [&](uint8_t id, uint8_t rdIndex, uint8_t rs1Index, uint8_t rs2Index, int32_t value, SymbolId sym,
+                    Modifier modifier = Modifier::None) {
+        program.add(id, rdIndex, rs1Index, rs2Index, value, sym, modifier, line.statement);
+    };
+
+    switch (pseudo.kind) {
+        case Pseudo::Nop:
+            emit(idAddi, 0, 0, 0, 0, noSymbolId);
+            return true;
+        case Pseudo::Mv:
+        case Pseudo::Neg:
+        case Pseudo::Sltz:
+        case Pseudo::Sgtz:
+            if (!parseRegister(operands[0], rd) || !parseRegister(operands[1], rs)) return false;
+            if (pseudo.kind == Pseudo::Mv) emit(idAddi, rd, rs, 0, 0, noSymbolId);
+            else if (pseudo.kind == Pseudo::Neg) emit(idSub, rd, 0, rs, 0, noSymbolId);
+            else if (pseudo.kind == Pseudo::Sltz) emit(idSlt, rd, rs, 0, 0, noSymbolId);
+            else emit(idSlt, rd, 0, rs, 0, noSymbolId);
+            return true;
+        case Pseudo::Li: {
+            if (!parseRegister(operands[0], rd) || !parseImmediate(operands[1], symbolTable, immediate)) return false;
+            if (immediate >= -2048 && immediate <= 2047) {
+                emit(idAddi, rd, 0, 0, immediate, noSymbolId);
+                return true;
+            }
+            int32_t upper, lower;
+            splitImmediate(immediate, upper, lower);
+            emit(idLui, rd, 0, 0, upper, noSymbolId);
+            if (lower != 0) emit(idAddi, rd, rd, 0, lower, noSymbolId);
+            return true;
         }
-        rs2 = rs2Str;
-    }
-    else if (opcode == "beq" || opcode == "bne" || opcode == "blt" || opcode == "bge") {
-        format = "SB"; // SB-format
-        iss >> rs1 >> rs2 >> immediate;
-        cout << "Immediate: " << immediate << endl;
-        if (!rs1.empty() && rs1.back() == ',') rs1.pop_back();
-        if (!rs2.empty() && rs2.back() == ',') rs2.pop_back();
-    }
-    else if (opcode == "lui" || opcode == "auipc") {
-        format = "U"; // U-format
-        iss >> rd >> immediate;
-        if(immediate[1]!='x'){
-            //convert decimal to hex
-            immediate=decimalToHex(stoi(immediate));
-            immediate="0x"+immediate;
-            //cout<<"Immediate: "<<immediate<<endl;
+        case Pseudo::La:
+            if (!parseRegister(operands[0], rd) || !parseTarget(operands[1], symbolTable, immediate, symbol) ||
+                symbol == noSymbolId) {
+                return false;
+            }
+            emit(idAuipc, rd, 0, 0, immediate, symbol, Modifier::PcrelHi);
+            emit(idAddi, rd, rd, 0, immediate, symbol, Modifier::PcrelLo);
+            return true;
+        case Pseudo::J:
+        case Pseudo::Jal:
+        case Pseudo::Call:
+        case Pseudo::Tail:
+            if (!parseTarget(operands[0], symbolTable, immediate, symbol)) return false;
+            rd = pseudo.kind == Pseudo::Jal || pseudo.kind == Pseudo::Call ? 1 : 0;
+            emit(idJal, rd, 0, 0, immediate, symbol);
+            return true;
+        case Pseudo::Jr:
+        case Pseudo::Jalr:
+            if (!parseRegister(operands[0], rs)) return false;
+            emit(idJalr, pseudo.kind == Pseudo::Jalr ? 1 : 0, rs, 0, 0, noSymbolId);
+            return true;
+        case Pseudo::Ret:
+            emit(idJalr, 0, 1, 0, 0, noSymbolId);
+            return true;
+        case Pseudo::Beqz:
+        case Pseudo::Bnez:
+        case Pseudo::Blez:
+        case Pseudo::Bgez:
+        case Pseudo::Bltz:
+        case Pseudo::Bgtz:
+            if (!parseRegister(operands[0], rs) || !parseTarget(operands[1], symbolTable, immediate, symbol)) return false;
+            switch (pseudo.kind) {
+                case Pseudo::Beqz: emit(idBeq, 0, rs, 0, immediate, symbol); break;
+                case Pseudo::Bnez: emit(idBne, 0, rs, 0, immediate, symbol); break;
+                case Pseudo::Blez: emit(idBge, 0, 0, rs, immediate, symbol); break;
+                case Pseudo::Bgez: emit(idBge, 0, rs, 0, immediate, symbol); break;
+                case Pseudo::Bltz: emit(idBlt, 0, rs, 0, immediate, symbol); break;
+                default: emit(idBlt, 0, 0, rs, immediate, symbol); break;
+            }
+            return true;
+        case Pseudo::Bgt:
+        case Pseudo::Ble:
+            // Swap the operands of blt/bge
+            if (!parseRegister(operands[0], rs) || !parseRegister(operands[1], rt) ||
+                !parseTarget(operands[2], symbolTable, immediate, symbol)) {
+                return false;
+            }
+            emit(pseudo.kind == Pseudo::Bgt ? idBlt : idBge, 0, rt, rs, immediate, symbol);
+            return true;
+    }
+    return false;
+}
+
+// Number of instructions a statement occupies before relaxation, used by
+// the label pass of two-pass parsing
+static size_t instructionLength(const SourceLine& line, SymbolTable& symbolTable) {
+    const InstructionDesc* desc = findInstruction(line.mnemonic);
+    if (desc != nullptr && line.operandCount >= operandCount(desc->shape)) return 1;
+    const PseudoDesc* pseudo = findPseudo(line.mnemonic, line.operandCount);
+    if (pseudo == nullptr) return 1; // Reported by the instruction pass
+    if (pseudo->length != 0) return pseudo->length;
+    int32_t value = 0;
+    return parseImmediate(line.operands[1], symbolTable, value) ? liLength(value) : 1;
+}
+
+// Whether a constant immediate fits its format's field: 12 bits for I and
+// S, 20 unsigned bits for U, and even byte offsets of 13 and 21 bits for SB
+// and UJ. An immediate naming a label is checked by layoutText instead.
+static bool immediateFits(Format format, int32_t value) {
+    switch (format) {
+        case Format::I:
+        case Format::S:
+            return value >= -2048 && value <= 2047;
+        case Format::U:
+            return value >= 0 && value <= 0xFFFFF;
+        case Format::SB:
+            return value % 2 == 0 && value >= -4096 && value <= 4094;
+        case Format::UJ:
+            return value % 2 == 0 && value >= -(1 << 20) && value < (1 << 20);
+        case Format::R:
+            break;
+    }
+    return true;
+}
+
+// Range-check the instructions appended for line from index first on
+static bool checkImmediates(const SourceLine& line, const Program& program, size_t first) {
+    for (size_t i = first; i < program.size(); i++) {
+        if (program.symbols[i] != noSymbolId || immediateFits(program.desc(i).format, program.immediates[i])) continue;
+        cerr << "Error: Immediate out of range in '" << line.statement << "' on line " << line.lineNumber << endl;
+        return false;
+    }
+    return true;
+}
+
+// Function to parse an instruction line and append it to the program; the
+// operand layout comes from the descriptor table. Pseudo-instructions may
+// append several instructions.
+bool parseInstructionFields(const SourceLine& line, Program& program, SymbolTable& symbolTable) {
+    const InstructionDesc* desc = findInstruction(line.mnemonic);
+    size_t first = program.size();
+    if (desc == nullptr || line.operandCount < operandCount(desc->shape)) {
+        if (const PseudoDesc* pseudo = findPseudo(line.mnemonic, line.operandCount)) {
+            if (expandPseudoInstruction(*pseudo, line, program, symbolTable)) return checkImmediates(line, program, first);
+            cerr << "Error: Invalid operands in '" << line.statement << "' on line " << line.lineNumber << endl;
+            return false;
         }
-        immediate = to_string(stoi(immediate, nullptr, 16)); // Convert hex to decimal
-        if (!rd.empty() && rd.back() == ',') rd.pop_back();
     }
-    else if (opcode == "jal") {
-        format = "UJ"; // UJ-format
-        iss >> rd >> immediate;
-        if (!rd.empty() && rd.back() == ',') rd.pop_back();
+    if (desc == nullptr) {
+        cerr << "Error: Unknown instruction '" << line.statement << "' on line " << line.lineNumber << endl;
+        return false;
     }
+
+    if (line.operandCount < operandCount(desc->shape)) {
+        cerr << "Error: Missing operands in '" << line.statement << "' on line " << line.lineNumber << endl;
+        return false;
+    }
+    if (line.operandCount > operandCount(desc->shape)) {
+        cerr << "Error: Invalid operands in '" << line.statement << "' on line " << line.lineNumber << endl;
+        return false;
+    }
+
+    const string_view* operands = line.operands;
+    uint8_t id = static_cast<uint8_t>(desc - instructionTable);
+    uint8_t rd = 0, rs1 = 0, rs2 = 0;
+    int32_t immediate = 0;
+    SymbolId symbol = noSymbolId;
+    Modifier modifier = Modifier::None;
+    bool ok = true;
+
+    switch (desc->shape) {
+        case OperandShape::RegRegReg:
+            ok = parseRegister(operands[0], rd) && parseRegister(operands[1], rs1) &&
+                 parseRegister(operands[2], rs2);
+            break;
+        case OperandShape::RegRegImm:
+            ok = parseRegister(operands[0], rd) && parseRegister(operands[1], rs1) &&
+                 parseImmediateOperand(operands[2], symbolTable, id, immediate, symbol, modifier);
+            break;
+        case OperandShape::RegMem:
+            ok = parseRegister(operands[0], rd) &&
+                 parseMemoryOperand(operands[1], symbolTable, id, immediate, symbol, modifier, rs1);
+            break;
+        case OperandShape::StoreMem:
+            ok = parseRegister(operands[0], rs2) &&
+                 parseMemoryOperand(operands[1], symbolTable, id, immediate, symbol, modifier, rs1);
+            break;
+        case OperandShape::RegRegLabel:
+            DEBUG_LOG("Immediate: " << operands[2]);
+            ok = parseRegister(operands[0], rs1) && parseRegister(operands[1], rs2) &&
+                 parseTarget(operands[2], symbolTable, immediate, symbol);
+            break;
+        case OperandShape::RegImm:
+            ok = parseRegister(operands[0], rd) &&
+                 parseImmediateOperand(operands[1], symbolTable, id, immediate, symbol, modifier);
+            break;
+        case OperandShape::RegLabel:
+            ok = parseRegister(operands[0], rd) && parseTarget(operands[1], symbolTable, immediate, symbol);
+            break;
+    }
+
+    if (!ok) {
+        cerr << "Error: Invalid operands in '" << line.statement << "' on line " << line.lineNumber << endl;
+        return false;
+    }
+    program.add(id, rd, rs1, rs2, immediate, symbol, modifier, line.statement);
+    return checkImmediates(line, program, first);
+}
+
+// Bytes per value of a data directive (.byte, .half, .word, .dword), or 0
+static uint32_t dataValueSize(string_view directive) {
+    return directive == ".word"    ? 4
+           : directive == ".half"  ? 2
+           : directive == ".byte"  ? 1
+           : directive == ".dword" ? 8
+                                   : 0;
+}
+
+// Text of an .asciiz operand, without its quotes
+static string_view stringLiteral(string_view operand) {
+    if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"') {
+        operand = operand.substr(1, operand.size() - 2);
+    }
+    return operand;
+}
+
+// Name and value of a .equ/.set line. The value is fixed here, so it may
+// use earlier constants but not labels.
+static bool parseConstantDefinition(const SourceLine& line, SymbolTable& symbolTable, string_view& name,
+                                    int64_t& value) {
+    string_view cursor = line.rest;
+    return nextToken(cursor, name) && !isdigit(static_cast<unsigned char>(name[0])) &&
+           parseConstant(cursor.substr(min(cursor.find_first_not_of(" \t,"), cursor.size())), symbolTable, value) &&
+           value >= INT32_MIN && value <= UINT32_MAX;
 }
 
 // Function to handle assembler directives
-void processDirective(const string& directive, istringstream& iss, SymbolTable& symbolTable, uint32_t& dataAddress) {
+bool processDirective(const SourceLine& line, SymbolTable& symbolTable, DataSegment& data, bool& inData) {
+    string_view directive = line.mnemonic;
+    string_view cursor = line.rest;
+    string_view token;
+    bool commas = line.rest.find(',') != string_view::npos;
+    int64_t value;
+
+    if (directive == ".section") {
+        // .section .text, .data or .rodata; read-only data goes into the data
+        // segment like .data, marked so that it can be pooled
+        nextToken(cursor, token);
+        if (token != ".text" && token != ".data" && token != ".rodata") {
+            cerr << "Error: Unknown section '" << token << "' on line " << line.lineNumber << endl;
+            return false;
+        }
+        directive = token;
+    }
+
     if (directive == ".text") {
-      //  cout << "[DEBUG] Switching to TEXT section." << endl;
+        DEBUG_LOG("Switching to TEXT section.");
+        inData = false;
+        data.setReadOnly(false);
     } 
-    else if (directive == ".data") {
-      //  cout << "[DEBUG] Switching to DATA section." << endl;
+    else if (directive == ".data" || directive == ".rodata") {
+        DEBUG_LOG("Switching to DATA section.");
+        inData = true;
+        data.setReadOnly(directive == ".rodata");
     } 
-    else if (directive == ".word") {
-        int value;
-        while (iss >> value) {
-           // cout << "[DEBUG] Storing word value: " << value << " at address 0x" << hex << dataAddress << endl;
-            symbolTable.addData(dataAddress, value);
-            dataAddress += 4;
+    else if (uint32_t size = dataValueSize(directive)) {
+        while (nextOperand(cursor, token, commas)) {
+            if (!parseConstant(token, symbolTable, value)) {
+                cerr << "Error: Invalid value '" << token << "' on line " << line.lineNumber << endl;
+                return false;
+            }
+            DEBUG_LOG("Storing value: " << value << " at address 0x" << hex << data.address() << dec);
+            if (size == 1) data.writeByte(static_cast<uint8_t>(value));
+            else if (size == 2) data.writeHalf(static_cast<uint16_t>(value));
+            else if (size == 4) data.writeWord(static_cast<uint32_t>(value));
+            else data.writeDword(static_cast<uint64_t>(value));
         }
-    } 
-    else if (directive == ".half") {
-        int value;
-        while (iss >> value) {
-           // cout << "[DEBUG] Storing halfword value: " << value << " at address 0x" << hex << dataAddress << endl;
-            symbolTable.addData(dataAddress, value & 0xFFFF);
-            dataAddress += 2;
+    }
+    else if (directive == ".asciiz") {
+        data.writeString(stringLiteral(line.rest));
+    }
+    else if (directive == ".align" || directive == ".balign") {
+        // .align n pads to 2^n bytes, .balign n pads to n bytes
+        if (!nextOperand(cursor, token, commas) || !parseConstant(token, symbolTable, value) || value < 0 ||
+            value > 31) {
+            cerr << "Error: Invalid alignment on line " << line.lineNumber << endl;
+            return false;
+        }
+        uint32_t alignment = directive == ".align" ? 1u << value : static_cast<uint32_t>(value);
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+            cerr << "Error: Alignment must be a power of two on line " << line.lineNumber << endl;
+            return false;
+        }
+        if (!inData) {
+            cerr << "Error: Alignment is only supported in the .data section (line " << line.lineNumber << ")" << endl;
+            return false;
         }
+        data.align(alignment);
     }
-    else if (directive == ".byte") {
-        int value;
-        while (iss >> value) {
-           // cout << "[DEBUG] Storing byte value: " << value << " at address 0x" << hex << dataAddress << endl;
-            symbolTable.addData(dataAddress, value & 0xFF);
-            dataAddress += 1;
+    else if (directive == ".equ" || directive == ".set") {
+        // .equ name, value; either directive may redefine a name
+        string_view name;
+        if (!parseConstantDefinition(line, symbolTable, name, value)) {
+            cerr << "Error: Invalid constant definition on line " << line.lineNumber << endl;
+            return false;
         }
+        symbolTable.addConstant(name, static_cast<int32_t>(value));
+        DEBUG_LOG("Defined constant: " << name << " = " << value);
     }
-    else if (directive == ".dword") {
-        int64_t value;
-        while (iss >> value) {
-           // cout << "[DEBUG] Storing double word (dword) value: " << value << " at address 0x" << hex << dataAddress << endl;
-            symbolTable.addData(dataAddress, value & 0xFFFFFFFFFFFFFFFF);
-            dataAddress += 8;
+    else if (directive == ".globl" || directive == ".global") {
+        // Global symbols are visible to other modules when linking
+        while (nextToken(cursor, token)) {
+            symbolTable.addGlobal(token);
+            DEBUG_LOG("Declared global symbol: " << token);
         }
     }
-    else if (directive == ".asciiz") {
-        string str;
-        getline(iss, str);
-        str = trimWhitespace(str);
-        if (str.front() == '"' && str.back() == '"') {
-            str = str.substr(1, str.size() - 2); // Remove quotes
+    else {
+        cerr << "Error: Unknown directive '" << directive << "' on line " << line.lineNumber << endl;
+        return false;
+    }
+    return true;
+}
+
+
+// Shared line loop. collectLabels records label addresses, emitInstructions
+// parses instruction lines; when emitting, text labels are also recorded by
+// instruction index in textLabels for layoutText. Instructions and data are
+// appended to what program and data already hold; a label pass that starts
+// partway through a file passes the text address it starts at. Parsing goes
+// on past an error, so that one run reports every bad line.
+static bool parseLines(Lexer& lexer, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                       bool collectLabels, bool emitInstructions, bool& inData, vector<TextLabel>* textLabels,
+                       uint32_t address = 0) {
+    SourceLine line;
+    bool ok = true;
+    // Instruction memory address before relaxation
+    if (emitInstructions) address = static_cast<uint32_t>(program.size() * 4);
+
+    while (lexer.next(line)) {
+        if (line.hasLabel) {
+            if (!line.label.empty() && !isdigit(line.label[0])) {
+                SymbolId id = noSymbolId;
+                if (collectLabels) {
+                    SymbolId existing = symbolTable.find(line.label);
+                    if (existing != noSymbolId && symbolTable.isLabel(existing)) {
+                        cerr << "Error: Duplicate label '" << line.label << "' on line " << line.lineNumber << endl;
+                        ok = false;
+                        id = existing;
+                    } else {
+                        id = symbolTable.addLabel(line.label, inData ? data.address() : address);
+                        DEBUG_LOG("Stored Label: '" << line.label << "' at Address: 0x" << hex << address << dec);
+                    }
+                }
+                if (textLabels != nullptr && !inData) {
+                    if (id == noSymbolId) id = symbolTable.intern(line.label);
+                    textLabels->push_back(TextLabel{id, static_cast<uint32_t>(program.size())});
+                }
+            } else {
+                cerr << "Error: Invalid label '" << line.label << "' - Labels cannot start with numbers!" << endl;
+                ok = false;
+            }
         }
-        for (char ch : str) {
-            symbolTable.addData(dataAddress, ch);
-            dataAddress++;
+        if (line.mnemonic.empty()) continue;
+
+        if (line.mnemonic[0] == '.') {  // Handle assembler directives
+            if (!processDirective(line, symbolTable, data, inData)) ok = false;
+            continue;
+        }
+
+        if (emitInstructions) {
+            if (!parseInstructionFields(line, program, symbolTable)) ok = false;
+            address = static_cast<uint32_t>(program.size() * 4);
+        } else {
+            address += static_cast<uint32_t>(instructionLength(line, symbolTable) * 4);
         }
-        symbolTable.addData(dataAddress, 0); // Null terminator
-        dataAddress++;
-    }
-    else if (directive == ".globl") {
-        string symbol;
-        iss >> symbol;
-        //cout << "[DEBUG] Declared global symbol: " << symbol << endl;
     }
+
+    return ok;
 }
 
+static bool parseSource(string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                        bool collectLabels, bool emitInstructions, vector<TextLabel>* textLabels) {
+    Lexer lexer(source);
+    bool inData = false;
 
-// Modify parseFile to recognize directives
-bool parseFile(const string& filename, vector<Instruction>& instructions, SymbolTable& symbolTable, bool firstPass) {
-    ifstream inFile(filename);
-    if (!inFile.is_open()) {
-        cerr << "Error: Could not open file " << filename << endl;
-        return false;
+    // Every pass rebuilds the data image, so label addresses and contents agree
+    data.clear();
+
+    if (emitInstructions) {
+        program.clear();
+        program.setSource(source);
     }
+    return parseLines(lexer, program, symbolTable, data, collectLabels, emitInstructions, inData, textLabels);
+}
 
-    string line;
-    uint32_t address = 0; // Instruction memory address
-    uint32_t dataAddress = 0x10000000; // Data section starts from here
+bool parseBlock(string_view block, uint32_t firstLine, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                bool& inData, vector<TextLabel>& textLabels) {
+    Lexer lexer(block, firstLine);
+    return parseLines(lexer, program, symbolTable, data, true, true, inData, &textLabels);
+}
 
-    while (getline(inFile, line)) {
-        line = removeComments(line);
-        line = trimWhitespace(line);
-        if (line.empty()) continue;
+namespace {
 
-        size_t colonPos = line.find(':');
+// One slice of the source in the parallel label pass. The slice is lexed on
+// its own thread without knowing the section it starts in or where its text
+// and data begin, so its labels are recorded relative to the slice and
+// placed once the slices before it are known.
+struct LabelChunk {
+    static constexpr int8_t unknownSection = -1, textSection = 0, dataSection = 1;
 
-        if (colonPos != string::npos) {
-            string label = trimWhitespace(line.substr(0, colonPos));
+    // Data bytes after an alignment; the first piece is not aligned
+    struct DataPiece {
+        uint32_t alignment;
+        uint32_t bytes;
+    };
+    struct Label {
+        SymbolId symbol;     // In symbols
+        uint32_t lineNumber; // Within the chunk
+        int8_t section;      // unknownSection before the chunk's first .text/.data
+        uint32_t textOffset;
+        uint32_t piece;
+        uint32_t dataOffset; // Within the piece
+    };
 
-            if (!label.empty() && !isdigit(label[0])) {
-                if (firstPass) {
-                    symbolTable.addLabel(label, address);
-                    //cout << "[DEBUG] Stored Label: '" << label << "' at Address: 0x" << hex << address << endl;
-                }
-            } else {
-                cerr << "Error: Invalid label '" << label << "' - Labels cannot start with numbers!" << endl;
-                return false;
-            }
+    string_view source;
+    SymbolTable constants; // Constants defined before the chunk
+    SymbolTable symbols;   // The chunk's names in order of first use
+    vector<Label> labels;
+    vector<DataPiece> pieces{{1, 0}};
+    uint32_t textBytes = 0;
+    uint32_t lines = 0;
+    int8_t section = unknownSection;
+    bool alignsInUnknownSection = false; // An error unless the chunk starts in .data
+    bool complete = false;               // Unset when the chunk holds an error
+};
 
-            if (colonPos + 1 < line.size()) {
-                line = trimWhitespace(line.substr(colonPos + 1));
-            } else {
-                continue;
-            }
+constexpr size_t minLabelChunk = 64 * 1024; // Bytes of source per thread
+
+} // namespace
+
+// Directive in a label chunk: section switches, data sizes, alignments,
+// constants and globals. False for anything left to the sequential pass,
+// errors included, so that they are reported in source order.
+static bool measureDirective(const SourceLine& line, LabelChunk& chunk) {
+    string_view directive = line.mnemonic;
+    string_view cursor = line.rest;
+    string_view token;
+    bool commas = line.rest.find(',') != string_view::npos;
+    int64_t value;
+
+    if (directive == ".section") {
+        if (!nextToken(cursor, directive) || (directive != ".text" && directive != ".data" && directive != ".rodata")) {
+            return false;
         }
+    }
 
-        istringstream iss(line);
-        string firstWord;
-        iss >> firstWord;
+    if (directive == ".text") {
+        chunk.section = LabelChunk::textSection;
+    }
+    else if (directive == ".data" || directive == ".rodata") {
+        chunk.section = LabelChunk::dataSection;
+    }
+    else if (uint32_t size = dataValueSize(directive)) {
+        while (nextOperand(cursor, token, commas)) {
+            if (!parseConstant(token, chunk.symbols, value)) return false;
+            chunk.pieces.back().bytes += size;
+        }
+    }
+    else if (directive == ".asciiz") {
+        chunk.pieces.back().bytes += static_cast<uint32_t>(stringLiteral(line.rest).size() + 1);
+    }
+    else if (directive == ".align" || directive == ".balign") {
+        // Padding depends on the absolute address, so a new piece starts here
+        if (chunk.section == LabelChunk::textSection || !nextOperand(cursor, token, commas) ||
+            !parseConstant(token, chunk.symbols, value) || value < 0 || value > 31) {
+            return false;
+        }
+        if (chunk.section == LabelChunk::unknownSection) chunk.alignsInUnknownSection = true;
+        uint32_t alignment = directive == ".align" ? 1u << value : static_cast<uint32_t>(value);
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0) return false;
+        chunk.pieces.push_back({alignment, 0});
+    }
+    else if (directive == ".equ" || directive == ".set") {
+        string_view name;
+        if (!parseConstantDefinition(line, chunk.symbols, name, value)) return false;
+        chunk.symbols.addConstant(name, static_cast<int32_t>(value));
+    }
+    else if (directive == ".globl" || directive == ".global") {
+        while (nextToken(cursor, token)) chunk.symbols.addGlobal(token);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
 
-        if (firstWord[0] == '.') {  // Handle assembler directives
-            processDirective(firstWord, iss, symbolTable, dataAddress);
-        } 
-        else if (!firstPass) {
-            Instruction instr;
-            parseInstructionFields(line, instr.line_name,instr.opcode, instr.format, instr.rd, instr.rs1, instr.rs2, instr.immediate);
+// Label pass over one chunk, as parseLines does it for the whole file
+static void collectChunkLabels(LabelChunk& chunk) {
+    chunk.lines = static_cast<uint32_t>(count(chunk.source.begin(), chunk.source.end(), '\n'));
+    Lexer lexer(chunk.source);
+    SourceLine line;
+    while (lexer.next(line)) {
+        if (line.hasLabel) {
+            if (line.label.empty() || isdigit(line.label[0])) return;
+            SymbolId id = chunk.symbols.find(line.label);
+            if (id != noSymbolId && chunk.symbols.isLabel(id)) return;
+            id = chunk.symbols.addLabel(line.label, 0);
+            chunk.labels.push_back({id, line.lineNumber, chunk.section, chunk.textBytes,
+                                    static_cast<uint32_t>(chunk.pieces.size() - 1), chunk.pieces.back().bytes});
+        }
+        if (line.mnemonic.empty()) continue;
+        if (line.mnemonic[0] == '.') {
+            if (!measureDirective(line, chunk)) return;
+            continue;
+        }
+        chunk.textBytes += static_cast<uint32_t>(instructionLength(line, chunk.symbols) * 4);
+    }
+    chunk.complete = true;
+}
 
-            if(instr.opcode=="auipc"){
-                instr.immediate=to_string(stoi(instr.immediate)+address);
-               
-            }
+// Constants may be redefined, so each chunk needs the ones defined before it.
+// .equ and .set lines are rare: they are found by their text and evaluated in
+// order before the chunks are lexed. One that does not evaluate is skipped;
+// the chunk holding it fails on it too.
+static void collectChunkConstants(string_view source, vector<LabelChunk>& chunks) {
+    struct Definition {
+        size_t offset;
+        string_view name;
+        int32_t value;
+    };
+    vector<Definition> definitions;
+    SymbolTable constants;
+    size_t equ = source.find(".equ"), set = source.find(".set");
+    while (min(equ, set) != string_view::npos) {
+        size_t found = min(equ, set);
+        size_t begin = source.rfind('\n', found);
+        begin = begin == string_view::npos ? 0 : begin + 1;
+        size_t end = min(source.find('\n', found), source.size());
+        Lexer lexer(source.substr(begin, end - begin));
+        SourceLine line;
+        string_view name;
+        int64_t value;
+        if (lexer.next(line) && (line.mnemonic == ".equ" || line.mnemonic == ".set") &&
+            parseConstantDefinition(line, constants, name, value)) {
+            constants.addConstant(name, static_cast<int32_t>(value));
+            definitions.push_back({begin, name, static_cast<int32_t>(value)});
+        }
+        if (equ < end) equ = source.find(".equ", end);
+        if (set < end) set = source.find(".set", end);
+    }
 
-            if ((instr.format == "SB" || instr.format == "UJ") && !instr.immediate.empty()) {
-                //cout<<"[DEBUG] Immediate: "<<instr.immediate<<endl;
-                if (!isdigit(instr.immediate[0])) {
-                    uint32_t labelAddress = symbolTable.getAddress(instr.immediate);
-                    //cout<<"[DEBUG] Label Address: "<<labelAddress<<endl;
-                    if (labelAddress != 0xFFFFFFFF) {
-                        uint32_t offset = (labelAddress - address);
-                        //cout<<"[DEBUG] Calculated Offset: "<<offset<<endl;
-                        instr.immediate = to_string(offset);
-                    } else {
-                        cerr << "Error: Label '" << instr.immediate << "' not found in symbol table." << endl;
-                        return false;
-                    }
-                }
-            }
+    for (LabelChunk& chunk : chunks) {
+        size_t start = chunk.source.data() - source.data();
+        for (const Definition& definition : definitions) {
+            if (definition.offset >= start) break;
+            chunk.constants.addConstant(definition.name, definition.value);
+        }
+        chunk.symbols.setOuterScope(&chunk.constants);
+    }
+}
+
+// Label pass of two-pass parsing on jobs threads. The source is split at
+// line boundaries; each chunk counts the text and data bytes it adds and
+// records its labels relative to itself, and a prefix sum over the chunks,
+// in order, gives their absolute addresses. Labels, constants and globals
+// enter the symbol table in the order a sequential pass would add them, and
+// duplicate labels are reported at each redefinition. From the first
+// chunk that holds an error the pass continues sequentially, so that errors
+// read the same either way. The data segment is laid out but zero-filled;
+// the instruction pass rebuilds it.
+static bool collectLabels(string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                          unsigned jobs) {
+    size_t chunkCount = parallelChunkCount(source.size(), jobs, minLabelChunk);
+    if (chunkCount == 1) return parseSource(source, program, symbolTable, data, true, false, nullptr);
 
-            instructions.push_back(instr);
+    vector<LabelChunk> chunks(chunkCount);
+    for (size_t c = 0, begin = 0; c < chunkCount; c++) {
+        size_t end = source.size();
+        if (c + 1 < chunkCount) {
+            end = min(source.find('\n', max(begin, source.size() * (c + 1) / chunkCount)), end - 1) + 1;
         }
+        chunks[c].source = source.substr(begin, end - begin);
+        begin = end;
+    }
+    collectChunkConstants(source, chunks);
+    parallelChunks(chunkCount, jobs, 1, [&](size_t, size_t first, size_t last) {
+        for (size_t c = first; c < last; c++) collectChunkLabels(chunks[c]);
+    });
 
-        address += 4; 
+    size_t symbolCount = 0;
+    for (const LabelChunk& chunk : chunks) symbolCount += chunk.symbols.size();
+    symbolTable.reserve(symbolCount);
+    data.clear();
+    uint32_t address = 0;
+    uint32_t lineNumber = 0;
+    bool inData = false;
+    bool ok = true;
+    vector<SymbolId> ids;
+    vector<uint32_t> pieceAddresses;
+    for (const LabelChunk& chunk : chunks) {
+        if (!chunk.complete || (chunk.alignsInUnknownSection && !inData)) {
+            Lexer lexer(source.substr(chunk.source.data() - source.data()), lineNumber);
+            bool rest = parseLines(lexer, program, symbolTable, data, true, false, inData, nullptr, address);
+            return ok && rest;
+        }
+
+        ids.resize(chunk.symbols.size());
+        for (SymbolId id = 0; id < chunk.symbols.size(); id++) {
+            string_view name = chunk.symbols.name(id);
+            ids[id] = symbolTable.intern(name);
+            if (chunk.symbols.isConstant(id)) symbolTable.addConstant(name, chunk.symbols.constant(id));
+            if (chunk.symbols.isGlobal(id)) symbolTable.addGlobal(name);
+        }
+        pieceAddresses.clear();
+        for (size_t p = 0; p < chunk.pieces.size(); p++) {
+            if (p > 0) data.align(chunk.pieces[p].alignment);
+            pieceAddresses.push_back(data.address());
+            data.skip(chunk.pieces[p].bytes);
+        }
+        for (const LabelChunk::Label& label : chunk.labels) {
+            SymbolId id = ids[label.symbol];
+            if (symbolTable.isLabel(id)) {
+                cerr << "Error: Duplicate label '" << symbolTable.name(id) << "' on line "
+                     << lineNumber + label.lineNumber << endl;
+                ok = false;
+                continue;
+            }
+            bool labelInData = label.section == LabelChunk::unknownSection ? inData
+                                                                          : label.section == LabelChunk::dataSection;
+            symbolTable.addLabel(id, labelInData ? pieceAddresses[label.piece] + label.dataOffset
+                                                 : address + label.textOffset);
+        }
+
+        address += chunk.textBytes;
+        lineNumber += chunk.lines;
+        if (chunk.section != LabelChunk::unknownSection) inData = chunk.section == LabelChunk::dataSection;
     }
+    return ok;
+}
 
-    inFile.close();
-    return true;
+// Whole-program passes after parsing: the optional block reordering and
+// data pooling, then the text layout that resolves every label operand.
+// Labels are resolved after a parse error too, to report undefined ones.
+static bool finishProgram(Program& program, SymbolTable& symbolTable, DataSegment& data,
+                          vector<TextLabel>& textLabels, bool parsed, bool compress, size_t* pooledBytes,
+                          const BlockProfile* profile, string* reorderedText) {
+    if (parsed && profile != nullptr) {
+        parsed = reorderBlocks(program, symbolTable, textLabels, *profile, *reorderedText);
+    }
+    if (parsed && pooledBytes != nullptr) *pooledBytes = poolReadOnlyData(data, symbolTable, textLabels);
+    return layoutText(program, symbolTable, textLabels, compress) && parsed;
+}
+
+// Two-pass parsing: the first pass collects labels, on jobs threads for
+// large inputs, the second parses instructions and lays out the text segment
+bool parseFile(string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data, bool firstPass,
+               bool compress, unsigned jobs, size_t* pooledBytes, const BlockProfile* profile, string* reorderedText) {
+    if (firstPass) return collectLabels(source, program, symbolTable, data, jobs);
+    vector<TextLabel> textLabels;
+    bool parsed = parseSource(source, program, symbolTable, data, false, true, &textLabels);
+    return finishProgram(program, symbolTable, data, textLabels, parsed, compress, pooledBytes, profile,
+                         reorderedText);
+}
+
+// Single-pass parsing: labels are collected while instructions are parsed,
+// and every label operand is resolved once the whole file has been seen.
+bool parseFileSinglePass(string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                         bool compress, size_t* pooledBytes, const BlockProfile* profile, string* reorderedText) {
+    vector<TextLabel> textLabels;
+    bool parsed = parseSource(source, program, symbolTable, data, true, true, &textLabels);
+    return finishProgram(program, symbolTable, data, textLabels, parsed, compress, pooledBytes, profile,
+                         reorderedText);
 }
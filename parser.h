@@ -2,25 +2,36 @@
 #define PARSER_H
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "symbol_table.h"
+#include "instruction_table.h"
+#include "lexer.h"
+#include "program.h"
+#include "data_segment.h"
+#include "relaxation.h"
+#include "block_order.h"
 using namespace std;
-//define the struct Instruction
-struct Instruction {
-    string line_name;
-    uint32_t address;       // Address of the instruction
-    std::string assembly;  // Assembly instruction as a string
-    std::string opcode="NULL";    // Opcode of the instruction
-    std::string func3="NULL";     // Func3 field
-    std::string func7="NULL";     // Func7 field
-    std::string rd="NULL";        // Destination register
-    std::string rs1="NULL";       // Source register 1
-    std::string rs2="NULL";       // Source register 2
-    std::string immediate="NULL"; // Immediate value
-    std::string format;    // Instruction format (e.g., "R", "I", "S")
-};
-//parseFile function will take the filename, instructions and symbolTable as input and return a boolean value
-bool parseFile(const std::string& filename, std::vector<Instruction>& instructions, SymbolTable& symbolTable,bool firstPass);
-string trimWhitespace(const string& str);
-string removeComments(const string& str);
+//parseFile function will take the source text, program and symbolTable as input and return a boolean value
+// compress selects RV32C forms wherever the operands fit (see layoutText);
+// the first pass splits large inputs across jobs threads (0 = all cores).
+// Before the text is laid out, blocks are reordered by profile when one is
+// given (see reorderBlocks), with their statements written to reorderedText,
+// and with pooledBytes set read-only data is pooled (see poolReadOnlyData)
+// and the bytes saved are stored there.
+bool parseFile(std::string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data, bool firstPass,
+               bool compress = false, unsigned jobs = 1, size_t* pooledBytes = nullptr,
+               const BlockProfile* profile = nullptr, std::string* reorderedText = nullptr);
+bool parseFileSinglePass(std::string_view source, Program& program, SymbolTable& symbolTable, DataSegment& data,
+                         bool compress = false, size_t* pooledBytes = nullptr, const BlockProfile* profile = nullptr,
+                         std::string* reorderedText = nullptr);
+// Parse one slice of a source file in single-pass mode, appending its
+// instructions, data and text labels. block must lie within the source set on
+// program; firstLine is the line number before it and inData the section it
+// starts in, updated to the section it ends in. Labels are left unresolved.
+bool parseBlock(std::string_view block, uint32_t firstLine, Program& program, SymbolTable& symbolTable,
+                DataSegment& data, bool& inData, std::vector<TextLabel>& textLabels);
+bool parseInstructionFields(const SourceLine& line, Program& program, SymbolTable& symbolTable);
+// Apply a directive line (.text, .data, .section, data and alignment directives, .equ/.set, .globl)
+bool processDirective(const SourceLine& line, SymbolTable& symbolTable, DataSegment& data, bool& inData);
 #endif
\ No newline at end of file
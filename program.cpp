@@ -0,0 +1,67 @@
+#include "program.h"
+
+using namespace std;
+
+// Drop all instructions but keep the allocated capacity for reuse
+void Program::clear() {
+    ids.clear();
+    rd.clear();
+    rs1.clear();
+    rs2.clear();
+    immediates.clear();
+    symbols.clear();
+    modifiers.clear();
+    sourceOffsets.clear();
+    sourceLengths.clear();
+    addresses.clear();
+}
+
+void Program::reserve(size_t count) {
+    ids.reserve(count);
+    rd.reserve(count);
+    rs1.reserve(count);
+    rs2.reserve(count);
+    immediates.reserve(count);
+    symbols.reserve(count);
+    modifiers.reserve(count);
+    sourceOffsets.reserve(count);
+    sourceLengths.reserve(count);
+}
+
+void Program::resize(size_t count) {
+    ids.resize(count);
+    rd.resize(count);
+    rs1.resize(count);
+    rs2.resize(count);
+    immediates.resize(count);
+    symbols.resize(count, noSymbolId);
+    modifiers.resize(count);
+    sourceOffsets.resize(count);
+    sourceLengths.resize(count);
+}
+
+void Program::copyEntry(size_t from, size_t to) {
+    ids[to] = ids[from];
+    rd[to] = rd[from];
+    rs1[to] = rs1[from];
+    rs2[to] = rs2[from];
+    immediates[to] = immediates[from];
+    symbols[to] = symbols[from];
+    modifiers[to] = modifiers[from];
+    sourceOffsets[to] = sourceOffsets[from];
+    sourceLengths[to] = sourceLengths[from];
+}
+
+size_t Program::add(uint8_t id, uint8_t rdIndex, uint8_t rs1Index, uint8_t rs2Index, int32_t immediate,
+                    SymbolId symbol, Modifier modifier, string_view statement) {
+    ids.push_back(id);
+    rd.push_back(rdIndex);
+    rs1.push_back(rs1Index);
+    rs2.push_back(rs2Index);
+    immediates.push_back(immediate);
+    symbols.push_back(symbol);
+    modifiers.push_back(modifier);
+    sourceOffsets.push_back(static_cast<uint32_t>(statement.data() - source.data()));
+    sourceLengths.push_back(static_cast<uint16_t>(statement.size() > 0xFFFF ? 0xFFFF : statement.size()));
+    return ids.size() - 1;
+}
@@ -0,0 +1,57 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "expression.h"
+#include "instruction_table.h"
+#include "symbol_table.h"
+
+// Compact in-memory form of the parsed text segment. Each field lives in its
+// own contiguous array (structure of arrays), indexed by instruction number;
+// the original source text is referenced by offset into the source buffer,
+// which must outlive the Program.
+class Program {
+public:
+    std::vector<uint8_t> ids;            // Row in instructionTable
+    std::vector<uint8_t> rd;             // Register indices (0 when unused)
+    std::vector<uint8_t> rs1;
+    std::vector<uint8_t> rs2;
+    std::vector<int32_t> immediates;     // Immediate; with a label operand the addend until layoutText resolves it
+    std::vector<SymbolId> symbols;       // Label operand, or noSymbolId
+    std::vector<Modifier> modifiers;     // Operator applied to the label operand (None for branches and jumps)
+    std::vector<uint32_t> sourceOffsets; // Start of the statement in the source buffer
+    std::vector<uint16_t> sourceLengths;
+    // Byte address of every instruction plus the end of the text segment, set
+    // by layoutText when RV32C forms are used; empty means 4 bytes each
+    std::vector<uint32_t> addresses;
+
+    void setSource(std::string_view text) { source = text; }
+    void clear();
+    void reserve(size_t count);
+
+    // Append an instruction and return its index
+    size_t add(uint8_t id, uint8_t rdIndex, uint8_t rs1Index, uint8_t rs2Index, int32_t immediate,
+               SymbolId symbol, Modifier modifier, std::string_view statement);
+
+    // Grow or shrink every field array; new entries are zeroed
+    void resize(size_t count);
+    // Copy every field of one entry over another
+    void copyEntry(size_t from, size_t to);
+
+    size_t size() const { return ids.size(); }
+    uint32_t address(size_t index) const {
+        return addresses.empty() ? static_cast<uint32_t>(index * 4) : addresses[index];
+    }
+    bool isCompressed(size_t index) const {
+        return !addresses.empty() && addresses[index + 1] - addresses[index] == 2;
+    }
+    uint32_t textSize() const { return address(size()); }
+    const InstructionDesc& desc(size_t index) const { return instructionTable[ids[index]]; }
+    std::string_view text(size_t index) const { return source.substr(sourceOffsets[index], sourceLengths[index]); }
+
+private:
+    std::string_view source;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <iostream>
+#include "relaxation.h"
+#include "compressed.h"
+#include "debug_log.h"
+
+using namespace std;
+
+static constexpr uint8_t idBeq = instructionId("beq");
+static constexpr uint8_t idBne = instructionId("bne");
+static constexpr uint8_t idBlt = instructionId("blt");
+static constexpr uint8_t idBge = instructionId("bge");
+static constexpr uint8_t idJal = instructionId("jal");
+static constexpr uint8_t idJalr = instructionId("jalr");
+static constexpr uint8_t idAuipc = instructionId("auipc");
+static constexpr uint8_t scratchRegister = 6; // t1, the base register of long far-jump forms
+
+static bool fitsSigned(int64_t value, int bits) {
+    return value >= -(int64_t(1) << (bits - 1)) && value < (int64_t(1) << (bits - 1));
+}
+
+uint8_t invertedBranch(uint8_t id) {
+    if (id == idBeq) return idBne;
+    if (id == idBne) return idBeq;
+    if (id == idBlt) return idBge;
+    return idBlt;
+}
+
+// Upper 20 bits of an offset for auipc/lui, rounded so that the sign-extended
+// low 12 bits added by the following instruction give the exact value
+static int32_t upperPart(int64_t value) {
+    return static_cast<int32_t>((value + 0x800) >> 12);
+}
+
+static int32_t lowerPart(int64_t value) {
+    return static_cast<int32_t>(value - (static_cast<int64_t>(upperPart(value)) << 12));
+}
+
+// Size classes of a relaxable branch or jump, smallest first
+enum Form : uint8_t {
+    Compressed, // c.beqz/c.bnez/c.j/c.jal
+    Short,      // The instruction itself
+    Medium,     // Inverted branch + jal, or auipc + jalr
+    Long        // Inverted branch + auipc + jalr
+};
+static constexpr int32_t formBytes[] = {2, 4, 8, 12};
+static constexpr size_t formEntries[] = {1, 1, 2, 3};
+
+static Form requiredForm(Format format, int64_t offset, bool compressible) {
+    if (format == Format::SB) {
+        if (compressible && fitsSigned(offset, 9)) return Compressed;
+        if (fitsSigned(offset, 13)) return Short;
+        return fitsSigned(offset - 4, 21) ? Medium : Long; // The jal sits one word after the branch
+    }
+    if (compressible && fitsSigned(offset, 12)) return Compressed;
+    return fitsSigned(offset, 21) ? Short : Medium;
+}
+
+// Addresses under the current forms: 4 bytes per instruction, less the
+// fixed-size compressed instructions before it (savedBefore, empty when not
+// compressing), adjusted by the size of each relaxable instruction before it
+class LayoutWalk {
+public:
+    LayoutWalk(const vector<uint32_t>& relaxable, const vector<uint8_t>& forms, const vector<uint32_t>& savedBefore)
+        : relaxable(relaxable), forms(forms), savedBefore(savedBefore) {}
+
+    // Address of instruction index; indices must not decrease between calls
+    uint32_t address(uint32_t index) {
+        while (next < relaxable.size() && relaxable[next] < index) delta += formBytes[forms[next++]] - 4;
+        int64_t saved = savedBefore.empty() ? 0 : savedBefore[index];
+        return static_cast<uint32_t>(int64_t(index) * 4 - saved + delta);
+    }
+
+private:
+    const vector<uint32_t>& relaxable;
+    const vector<uint8_t>& forms;
+    const vector<uint32_t>& savedBefore;
+    size_t next = 0;
+    int64_t delta = 0;
+};
+
+// Write the long form of relaxable instruction from at index to, which has
+// room for the extra instructions after it
+static void expandEntry(Program& program, size_t from, size_t to, Form form) {
+    size_t extra = formEntries[form] - 1;
+    for (size_t k = extra + 1; k-- > 0;) program.copyEntry(from, to + k);
+    SymbolId symbol = program.symbols[to];
+    int32_t addend = program.immediates[to];
+    auto set = [&](size_t index, uint8_t id, uint8_t rd, uint8_t rs1, uint8_t rs2, int32_t immediate, SymbolId sym,
+                   Modifier modifier) {
+        program.ids[index] = id;
+        program.rd[index] = rd;
+        program.rs1[index] = rs1;
+        program.rs2[index] = rs2;
+        program.immediates[index] = immediate;
+        program.symbols[index] = sym;
+        program.modifiers[index] = modifier;
+    };
+
+    if (program.desc(to).format == Format::SB) {
+        // Skip over the far jump when the original condition is false
+        set(to, invertedBranch(program.ids[to]), 0, program.rs1[to], program.rs2[to], formBytes[form], noSymbolId,
+            Modifier::None);
+        if (form == Medium) {
+            set(to + 1, idJal, 0, 0, 0, addend, symbol, Modifier::None);
+        } else {
+            set(to + 1, idAuipc, scratchRegister, 0, 0, addend, symbol, Modifier::PcrelHi);
+            set(to + 2, idJalr, 0, scratchRegister, 0, addend, symbol, Modifier::PcrelLo);
+        }
+    } else {
+        uint8_t rd = program.rd[to];
+        uint8_t base = rd != 0 ? rd : scratchRegister;
+        set(to, idAuipc, base, 0, 0, addend, symbol, Modifier::PcrelHi);
+        set(to + 1, idJalr, rd, base, 0, addend, symbol, Modifier::PcrelLo);
+    }
+}
+
+bool layoutText(Program& program, SymbolTable& symbolTable, const vector<TextLabel>& labels, bool compress) {
+    size_t count = program.size();
+
+    // Branches and jumps whose target is a label can change size. With
+    // compression, every other instruction without a label operand has a
+    // size known now.
+    vector<uint32_t> relaxable;
+    vector<uint8_t> forms;
+    vector<uint8_t> compressed(compress ? count : 0, 0);
+    vector<uint32_t> savedBefore(compress ? count + 1 : 0, 0);
+    for (size_t i = 0; i < count; i++) {
+        Format format = program.desc(i).format;
+        bool hasLabel = program.symbols[i] != noSymbolId;
+        if (hasLabel && (format == Format::SB || format == Format::UJ)) {
+            // A zero offset fits every compressed branch, so this only checks the registers
+            bool compressible = compress && compressInstruction(program.ids[i], program.rd[i], program.rs1[i],
+                                                                program.rs2[i], 0) != 0;
+            relaxable.push_back(static_cast<uint32_t>(i));
+            forms.push_back(compressible ? Compressed : Short);
+        } else if (compress && !hasLabel) {
+            compressed[i] = compressInstruction(program.ids[i], program.rd[i], program.rs1[i], program.rs2[i],
+                                                program.immediates[i]) != 0;
+        }
+        if (compress) savedBefore[i + 1] = savedBefore[i] + (compressed[i] ? 2 : 0);
+    }
+
+    // Grow out-of-range forms until the layout is stable. Forms never shrink,
+    // so this terminates. A round measures every offset under one layout, the
+    // one the labels were placed by, so growth is only applied after it.
+    bool grew;
+    size_t rounds = 0;
+    vector<uint8_t> grown;
+    do {
+        grew = false;
+        rounds++;
+        LayoutWalk labelWalk(relaxable, forms, savedBefore);
+        for (const TextLabel& label : labels) symbolTable.setAddress(label.symbol, labelWalk.address(label.index));
+
+        grown = forms;
+        LayoutWalk walk(relaxable, forms, savedBefore);
+        for (size_t r = 0; r < relaxable.size(); r++) {
+            uint32_t index = relaxable[r];
+            int64_t address = walk.address(index);
+            SymbolId symbol = program.symbols[index];
+            if (!symbolTable.isLabel(symbol)) continue; // Reported when resolving
+            int64_t offset = static_cast<int64_t>(symbolTable.address(symbol)) + program.immediates[index] - address;
+            Form needed = requiredForm(program.desc(index).format, offset, forms[r] == Compressed);
+            if (needed > forms[r]) {
+                grown[r] = needed;
+                grew = true;
+            }
+        }
+        forms.swap(grown);
+    } while (grew);
+
+    // Expand in place from the back; every entry moves right by the extra
+    // instructions of the relaxed ones before it
+    size_t extra = 0;
+    for (uint8_t form : forms) extra += formEntries[form] - 1;
+    DEBUG_LOG("Relaxation: " << rounds << " rounds, " << extra << " extra instructions");
+    if (compress) {
+        for (size_t r = 0; r < relaxable.size(); r++) compressed[relaxable[r]] = forms[r] == Compressed;
+    }
+    if (extra > 0) {
+        program.resize(count + extra);
+        if (compress) compressed.resize(count + extra, 0);
+        size_t shift = extra;
+        size_t r = relaxable.size();
+        for (size_t i = count; i-- > 0 && shift > 0;) {
+            if (r > 0 && relaxable[r - 1] == i) {
+                r--;
+                Form form = static_cast<Form>(forms[r]);
+                shift -= formEntries[form] - 1;
+                if (form > Short) {
+                    expandEntry(program, i, i + shift, form);
+                    if (compress) fill_n(compressed.begin() + i + shift, formEntries[form], 0);
+                    continue;
+                }
+            }
+            program.copyEntry(i, i + shift);
+            if (compress) compressed[i + shift] = compressed[i];
+        }
+    }
+
+    // Byte addresses, needed only once some instruction is 2 bytes
+    program.addresses.clear();
+    if (find(compressed.begin(), compressed.end(), 1) != compressed.end()) {
+        program.addresses.resize(program.size() + 1);
+        program.addresses[0] = 0;
+        for (size_t i = 0; i < program.size(); i++) {
+            program.addresses[i + 1] = program.addresses[i] + (compressed[i] ? 2 : 4);
+        }
+    }
+
+    // Resolve every label operand against the final layout, reporting each
+    // undefined label once
+    bool resolved = true;
+    vector<bool> reported;
+    for (size_t i = 0; i < program.size(); i++) {
+        SymbolId symbol = program.symbols[i];
+        if (symbol == noSymbolId) continue;
+        if (!symbolTable.isLabel(symbol)) {
+            reported.resize(symbolTable.size());
+            if (!reported[symbol]) {
+                cerr << "Error: Label '" << symbolTable.name(symbol) << "' not found in symbol table." << endl;
+                reported[symbol] = true;
+            }
+            resolved = false;
+            continue;
+        }
+        // %pcrel_lo takes the low part relative to the auipc just before, which must name the same symbol
+        bool paired = program.modifiers[i] == Modifier::PcrelLo;
+        if (paired && (i == 0 || program.ids[i - 1] != idAuipc || program.symbols[i - 1] != symbol)) {
+            cerr << "Error: %pcrel_lo in '" << program.text(i) << "' does not follow an auipc of the same label"
+                 << endl;
+            resolved = false;
+            continue;
+        }
+        int64_t target = static_cast<int64_t>(symbolTable.address(symbol)) + program.immediates[i];
+        program.immediates[i] = resolveImmediate(program.ids[i], program.address(i), target,
+                                                 paired ? int64_t(program.address(i - 1)) : int64_t(-1));
+    }
+    return resolved;
+}
+
+int32_t resolveImmediate(uint8_t id, int64_t pc, int64_t target, int64_t pairAddress) {
+    switch (instructionTable[id].format) {
+        case Format::SB:
+        case Format::UJ:
+            return static_cast<int32_t>(target - pc);
+        case Format::U:
+            // auipc is pc-relative, lui absolute
+            return upperPart(id == idAuipc ? target - pc : target);
+        case Format::I:
+        case Format::S:
+            return lowerPart(pairAddress >= 0 ? target - pairAddress : target);
+        case Format::R:
+            break;
+    }
+    return 0;
+}
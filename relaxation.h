@@ -0,0 +1,42 @@
+#ifndef RELAXATION_H
+#define RELAXATION_H
+#include <cstdint>
+#include <vector>
+#include "program.h"
+#include "symbol_table.h"
+
+// A label defined in the text segment, recorded by the instruction index it
+// precedes so that its address can move while branches are relaxed
+struct TextLabel {
+    SymbolId symbol;
+    uint32_t index;
+};
+
+// Final text layout. Branches and jumps to labels start in their short form;
+// any whose target is out of range grows into a longer sequence and label
+// addresses are recomputed until nothing changes:
+//   SB  beq a, b, L       -> bne a, b, +8; jal x0, L              (beyond +-4 KiB)
+//                         -> bne a, b, +12; auipc x6, hi; jalr x0, lo(x6)  (beyond +-1 MiB)
+//   UJ  jal rd, L         -> auipc rd, hi; jalr rd, lo(rd)        (x6 as the base when rd is x0)
+// Forms only ever grow, so the iteration terminates. Afterwards every label
+// operand is resolved: SB/UJ to byte offsets, auipc to the upper part of a
+// pc-relative offset, %pcrel_lo to the lower part relative to the auipc just
+// before it and %lo to the lower part of the absolute address.
+// Text label addresses in the symbol table are updated to the final layout.
+//
+// With compress set, instructions whose operands fit an RV32C form take 2
+// bytes (see compressed.h), branches and jumps to labels start compressed
+// when their registers allow it, and program.addresses records the
+// variable-length layout.
+bool layoutText(Program& program, SymbolTable& symbolTable, const std::vector<TextLabel>& labels, bool compress);
+
+// The immediate of instruction id at pc for a label operand, where target is
+// the label's address plus the addend. pairAddress is the address of the
+// auipc an I/S-format instruction takes its low part relative to, or -1 for
+// the low part of the absolute address.
+int32_t resolveImmediate(uint8_t id, int64_t pc, int64_t target, int64_t pairAddress);
+
+// Conditional branch (by instructionTable row) with the opposite condition
+uint8_t invertedBranch(uint8_t id);
+
+#endif
@@ -0,0 +1,312 @@
+#include "simulator.h"
+#include <array>
+#include <chrono>
+#include "compressed.h"
+#include "encoder.h"
+#include "instruction_table.h"
+#include "output_writer.h"
+
+using namespace std;
+
+// Computed goto is a GCC/Clang extension; other compilers use the switch loop
+#if defined(__GNUC__)
+#define SIM_THREADED 1
+#endif
+
+namespace {
+
+// Execution handlers. The first group follows the rows of instructionTable
+// and is matched by mnemonic; the rest are internal.
+enum Op : uint8_t {
+    Add, Sub, Xor, Or, And, Sll, Slt, Sra, Srl, Mul, Div, Rem,
+    Addi, Andi, Ori, Lb, Lh, Lw, Ld, Jalr,
+    Sb, Sh, Sw, Sd,
+    Beq, Bne, Blt, Bge,
+    Lui, Auipc, Jal,
+    End,        // Fell off the end of the text segment
+    BadTarget,  // Taken branch/jal to an address that is not an instruction; pc is the source
+    Illegal,    // Word that is not a supported instruction
+    OpCount
+};
+
+constexpr string_view opMnemonics[] = {
+    "add", "sub", "xor", "or", "and", "sll", "slt", "sra", "srl", "mul", "div", "rem",
+    "addi", "andi", "ori", "lb", "lh", "lw", "ld", "jalr",
+    "sb", "sh", "sw", "sd",
+    "beq", "bne", "blt", "bge",
+    "lui", "auipc", "jal",
+};
+static_assert(sizeof(opMnemonics) / sizeof(opMnemonics[0]) == instructionCount,
+              "every instruction in instructionTable needs a simulator handler");
+
+constexpr Op opForMnemonic(string_view mnemonic) {
+    for (size_t i = 0; i < instructionCount; i++) {
+        if (opMnemonics[i] == mnemonic) return static_cast<Op>(i);
+    }
+    return Illegal;
+}
+
+// Handler for each instructionTable row
+constexpr array<Op, instructionCount> buildRowOps() {
+    array<Op, instructionCount> ops{};
+    for (size_t i = 0; i < instructionCount; i++) ops[i] = opForMnemonic(instructionTable[i].mnemonic);
+    return ops;
+}
+
+constexpr array<Op, instructionCount> rowOps = buildRowOps();
+
+// Little-endian memory access
+inline uint32_t loadLE(const uint8_t* p, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++) value |= static_cast<uint32_t>(p[i]) << (8 * i);
+    return value;
+}
+
+inline void storeLE(uint8_t* p, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+} // namespace
+
+const char* stopReasonName(StopReason reason) {
+    switch (reason) {
+        case StopReason::Finished: return "finished";
+        case StopReason::StepLimit: return "step limit reached";
+        case StopReason::IllegalInstruction: return "illegal instruction";
+        case StopReason::MemoryFault: return "memory fault";
+        case StopReason::BadJump: return "jump outside the text segment";
+    }
+    return "";
+}
+
+void Simulator::load(const vector<uint32_t>& code, const uint8_t* data, size_t dataSize, size_t memorySize) {
+    words = code;
+    dataMemory.assign(max(memorySize, dataSize), 0);
+    if (dataSize > 0) copy(data, data + dataSize, dataMemory.begin());
+    predecode();
+}
+
+bool Simulator::loadListing(const string& filename, size_t memorySize) {
+    vector<uint32_t> code;
+    vector<uint8_t> data;
+    if (!readTextListing(filename, code, data)) return false;
+    load(code, data.data(), data.size(), memorySize);
+    return true;
+}
+
+// Decode every word once: handler, register indices, sign-extended immediate
+// and, for branches and jal, the index of the target record. RV32C words
+// are expanded to the 32-bit instruction they stand for.
+void Simulator::predecode() {
+    size_t count = words.size();
+    decoded.assign(count + 1, Decoded{nullptr, Illegal, 32, 0, 0, 0, 0, 0});
+
+    // Instruction start addresses, and the record starting at each halfword
+    uint32_t textSize = 0;
+    for (uint32_t word : words) textSize += instructionLength(word);
+    recordAt.assign(textSize / 2 + 1, noRecord);
+    uint32_t pc = 0;
+    for (size_t i = 0; i <= count; i++) {
+        decoded[i].pc = pc;
+        recordAt[pc / 2] = static_cast<uint32_t>(i);
+        if (i < count) pc += instructionLength(words[i]);
+    }
+    decoded[count].op = End;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word = words[i];
+        if (isCompressedWord(word)) word = expandCompressed(static_cast<uint16_t>(word));
+        Decoded& d = decoded[i];
+        const InstructionDesc* desc = word == 0 ? nullptr : findInstructionByEncoding(word);
+        if (desc == nullptr) continue;
+        d.op = rowOps[desc - instructionTable];
+        d.rd = decodeRd(word) == 0 ? 32 : static_cast<uint8_t>(decodeRd(word));
+        d.rs1 = static_cast<uint8_t>(decodeRs1(word));
+        d.rs2 = static_cast<uint8_t>(decodeRs2(word));
+        switch (desc->format) {
+            case Format::R: break;
+            case Format::I: d.imm = decodeImmI(word); break;
+            case Format::S: d.imm = decodeImmS(word); break;
+            case Format::U: d.imm = static_cast<int32_t>(static_cast<uint32_t>(decodeImmU(word)) << 12); break;
+            case Format::SB:
+            case Format::UJ: {
+                d.imm = desc->format == Format::SB ? decodeImmSB(word) : decodeImmUJ(word);
+                int64_t target = static_cast<int64_t>(d.pc) + d.imm;
+                if (target >= 0 && target <= textSize && recordAt[target / 2] != noRecord) {
+                    d.target = recordAt[target / 2];
+                } else {
+                    // Each bad target gets its own fault record so the source is known
+                    d.target = static_cast<uint32_t>(decoded.size());
+                    decoded.push_back(Decoded{nullptr, BadTarget, 32, 0, 0, 0, 0, decoded[i].pc});
+                }
+                break;
+            }
+        }
+    }
+}
+
+SimulationResult Simulator::run(uint64_t maxSteps) {
+    if (!profiling) return execute<false>(maxSteps);
+    counts.assign(decoded.size(), 0);
+    return execute<true>(maxSteps);
+}
+
+uint64_t Simulator::executions(uint32_t address) const {
+    if (address / 2 >= recordAt.size() || recordAt[address / 2] == noRecord || counts.empty()) return 0;
+    return counts[recordAt[address / 2]];
+}
+
+// The interpreter loop; with profile set it also counts every record it runs
+template <bool profile>
+SimulationResult Simulator::execute(uint64_t maxSteps) {
+    SimulationResult result;
+    fill(begin(regs), end(regs), 0);
+    regs[2] = static_cast<uint32_t>(dataBase + dataMemory.size()); // sp: top of data memory
+    regs[3] = dataBase;                                             // gp
+
+    uint32_t* const R = regs;
+    uint8_t* const memory = dataMemory.data();
+    const uint32_t memorySize = static_cast<uint32_t>(dataMemory.size());
+    Decoded* const base = decoded.data();
+    const uint32_t* const records = recordAt.data();
+    const uint32_t halfwords = static_cast<uint32_t>(recordAt.size());
+    Decoded* ip = base;
+    uint64_t* const executed = counts.data();
+    uint64_t budget = maxSteps;
+    uint32_t address = 0;
+
+#ifdef SIM_THREADED
+    static const void* const handlers[OpCount] = {
+        &&op_Add, &&op_Sub, &&op_Xor, &&op_Or, &&op_And, &&op_Sll, &&op_Slt, &&op_Sra, &&op_Srl,
+        &&op_Mul, &&op_Div, &&op_Rem,
+        &&op_Addi, &&op_Andi, &&op_Ori, &&op_Lb, &&op_Lh, &&op_Lw, &&op_Ld, &&op_Jalr,
+        &&op_Sb, &&op_Sh, &&op_Sw, &&op_Sd,
+        &&op_Beq, &&op_Bne, &&op_Blt, &&op_Bge,
+        &&op_Lui, &&op_Auipc, &&op_Jal,
+        &&op_End, &&op_BadTarget, &&op_Illegal,
+    };
+    for (Decoded& d : decoded) d.handler = handlers[d.op];
+#define OP(name) op_##name:
+#define NEXT() do { if (budget == 0) goto stepLimit; budget--; COUNT(); goto *ip->handler; } while (0)
+#else
+#define OP(name) case name:
+#define NEXT() do { if (budget == 0) goto stepLimit; budget--; COUNT(); goto dispatch; } while (0)
+#endif
+#define COUNT() do { if constexpr (profile) executed[ip - base]++; } while (0)
+
+// Data address check; leaves the memory offset in address
+#define MEMORY(bytes) \
+    address = R[ip->rs1] + static_cast<uint32_t>(ip->imm) - dataBase; \
+    if (address > memorySize || memorySize - address < (bytes)) goto memoryFault
+
+    auto start = chrono::steady_clock::now();
+    NEXT();
+
+#ifndef SIM_THREADED
+dispatch:
+    switch (ip->op) {
+#endif
+    OP(Add) R[ip->rd] = R[ip->rs1] + R[ip->rs2]; ip++; NEXT();
+    OP(Sub) R[ip->rd] = R[ip->rs1] - R[ip->rs2]; ip++; NEXT();
+    OP(Xor) R[ip->rd] = R[ip->rs1] ^ R[ip->rs2]; ip++; NEXT();
+    OP(Or) R[ip->rd] = R[ip->rs1] | R[ip->rs2]; ip++; NEXT();
+    OP(And) R[ip->rd] = R[ip->rs1] & R[ip->rs2]; ip++; NEXT();
+    OP(Sll) R[ip->rd] = R[ip->rs1] << (R[ip->rs2] & 0x1F); ip++; NEXT();
+    OP(Slt) R[ip->rd] = static_cast<int32_t>(R[ip->rs1]) < static_cast<int32_t>(R[ip->rs2]); ip++; NEXT();
+    OP(Sra) R[ip->rd] = static_cast<uint32_t>(static_cast<int32_t>(R[ip->rs1]) >> (R[ip->rs2] & 0x1F)); ip++; NEXT();
+    OP(Srl) R[ip->rd] = R[ip->rs1] >> (R[ip->rs2] & 0x1F); ip++; NEXT();
+    OP(Mul) R[ip->rd] = R[ip->rs1] * R[ip->rs2]; ip++; NEXT();
+    OP(Div) {
+        // Division by zero gives -1; INT_MIN / -1 overflows to INT_MIN
+        int32_t a = static_cast<int32_t>(R[ip->rs1]), b = static_cast<int32_t>(R[ip->rs2]);
+        if (b == 0) R[ip->rd] = 0xFFFFFFFF;
+        else if (a == INT32_MIN && b == -1) R[ip->rd] = static_cast<uint32_t>(a);
+        else R[ip->rd] = static_cast<uint32_t>(a / b);
+        ip++; NEXT();
+    }
+    OP(Rem) {
+        // Remainder by zero gives the dividend; INT_MIN % -1 is 0
+        int32_t a = static_cast<int32_t>(R[ip->rs1]), b = static_cast<int32_t>(R[ip->rs2]);
+        if (b == 0) R[ip->rd] = static_cast<uint32_t>(a);
+        else if (a == INT32_MIN && b == -1) R[ip->rd] = 0;
+        else R[ip->rd] = static_cast<uint32_t>(a % b);
+        ip++; NEXT();
+    }
+    OP(Addi) R[ip->rd] = R[ip->rs1] + static_cast<uint32_t>(ip->imm); ip++; NEXT();
+    OP(Andi) R[ip->rd] = R[ip->rs1] & static_cast<uint32_t>(ip->imm); ip++; NEXT();
+    OP(Ori) R[ip->rd] = R[ip->rs1] | static_cast<uint32_t>(ip->imm); ip++; NEXT();
+    OP(Lb) { MEMORY(1); R[ip->rd] = static_cast<uint32_t>(signExtend(memory[address], 8)); ip++; NEXT(); }
+    OP(Lh) { MEMORY(2); R[ip->rd] = static_cast<uint32_t>(signExtend(loadLE(memory + address, 2), 16)); ip++; NEXT(); }
+    OP(Lw) { MEMORY(4); R[ip->rd] = loadLE(memory + address, 4); ip++; NEXT(); }
+    OP(Ld) { MEMORY(8); R[ip->rd] = loadLE(memory + address, 4); ip++; NEXT(); } // Registers are 32 bits wide
+    OP(Jalr) {
+        uint32_t target = (R[ip->rs1] + static_cast<uint32_t>(ip->imm)) & ~1u;
+        if (target / 2 >= halfwords || records[target / 2] == noRecord) goto badJump;
+        R[ip->rd] = (ip + 1)->pc;
+        ip = base + records[target / 2];
+        NEXT();
+    }
+    OP(Sb) { MEMORY(1); memory[address] = static_cast<uint8_t>(R[ip->rs2]); ip++; NEXT(); }
+    OP(Sh) { MEMORY(2); storeLE(memory + address, R[ip->rs2], 2); ip++; NEXT(); }
+    OP(Sw) { MEMORY(4); storeLE(memory + address, R[ip->rs2], 4); ip++; NEXT(); }
+    OP(Sd) { MEMORY(8); storeLE(memory + address, static_cast<uint64_t>(static_cast<int64_t>(static_cast<int32_t>(R[ip->rs2]))), 8); ip++; NEXT(); }
+    OP(Beq) ip = R[ip->rs1] == R[ip->rs2] ? base + ip->target : ip + 1; NEXT();
+    OP(Bne) ip = R[ip->rs1] != R[ip->rs2] ? base + ip->target : ip + 1; NEXT();
+    OP(Blt) ip = static_cast<int32_t>(R[ip->rs1]) < static_cast<int32_t>(R[ip->rs2]) ? base + ip->target : ip + 1; NEXT();
+    OP(Bge) ip = static_cast<int32_t>(R[ip->rs1]) >= static_cast<int32_t>(R[ip->rs2]) ? base + ip->target : ip + 1; NEXT();
+    OP(Lui) R[ip->rd] = static_cast<uint32_t>(ip->imm); ip++; NEXT();
+    OP(Auipc) R[ip->rd] = ip->pc + static_cast<uint32_t>(ip->imm); ip++; NEXT();
+    OP(Jal) R[ip->rd] = (ip + 1)->pc; ip = base + ip->target; NEXT();
+    OP(End) {
+        budget++; // Reaching the end is not an instruction
+        result.reason = StopReason::Finished;
+        result.pc = ip->pc;
+        goto done;
+    }
+    OP(BadTarget) {
+        budget++;
+        result.reason = StopReason::BadJump;
+        result.pc = ip->pc;
+        goto done;
+    }
+    OP(Illegal) {
+        result.reason = StopReason::IllegalInstruction;
+        result.pc = ip->pc;
+        goto done;
+    }
+#ifndef SIM_THREADED
+    default: break;
+    }
+#endif
+
+#undef OP
+#undef NEXT
+#undef COUNT
+#undef MEMORY
+
+memoryFault:
+    result.reason = StopReason::MemoryFault;
+    result.pc = ip->pc;
+    goto done;
+badJump:
+    result.reason = StopReason::BadJump;
+    result.pc = ip->pc;
+    goto done;
+stepLimit:
+    if (ip->op == End) {
+        result.reason = StopReason::Finished;
+        result.pc = ip->pc;
+    } else {
+        result.reason = StopReason::StepLimit;
+        result.pc = ip->pc;
+    }
+done:
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    // A faulting instruction consumed budget without completing
+    result.steps = maxSteps - budget;
+    if (result.reason == StopReason::IllegalInstruction || result.reason == StopReason::MemoryFault ||
+        (result.reason == StopReason::BadJump && ip->op == Jalr)) {
+        result.steps--;
+    }
+    return result;
+}
@@ -0,0 +1,74 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "data_segment.h"
+
+// Why a simulation stopped
+enum class StopReason { Finished, StepLimit, IllegalInstruction, MemoryFault, BadJump };
+
+struct SimulationResult {
+    StopReason reason = StopReason::Finished;
+    uint64_t steps = 0;     // Instructions executed
+    double seconds = 0;
+    uint32_t pc = 0;        // Address of the instruction that stopped the run
+};
+
+// RV32IM execution engine for the assembled output. The text segment is
+// predecoded once into compact dispatch records (handler, operand indices,
+// sign-extended immediate, precomputed branch target) and run by a threaded
+// interpreter loop; RV32C words are expanded while predecoding. Data memory
+// is byte addressable from 0x10000000; x0 is hardwired to zero. Execution
+// finishes when control reaches the end of the text segment.
+class Simulator {
+public:
+    static constexpr uint32_t dataBase = DataSegment::baseAddress;
+
+    // Load encoded words (text at address 0) and the data image. memorySize is
+    // the size of data memory; sp starts at its top.
+    void load(const std::vector<uint32_t>& code, const uint8_t* data, size_t dataSize, size_t memorySize = 1 << 20);
+    // Load a .mc listing as written by the assembler
+    bool loadListing(const std::string& filename, size_t memorySize = 1 << 20);
+
+    SimulationResult run(uint64_t maxSteps);
+
+    // Count how often each instruction runs; the counting loop is a separate
+    // instantiation, so runs without it pay nothing
+    void setProfiling(bool enabled) { profiling = enabled; }
+    // Times the instruction at address ran in the last profiled run
+    uint64_t executions(uint32_t address) const;
+
+    uint32_t reg(int index) const { return regs[index]; }
+    const std::vector<uint8_t>& memory() const { return dataMemory; }
+
+private:
+    // One predecoded instruction
+    struct Decoded {
+        const void* handler;  // Computed goto target, filled in by run()
+        uint8_t op;
+        uint8_t rd;           // 32 for writes to x0, which are discarded
+        uint8_t rs1;
+        uint8_t rs2;
+        int32_t imm;
+        uint32_t target;      // Record index of a branch/jal target
+        uint32_t pc;          // Address of the instruction
+    };
+    static constexpr uint32_t noRecord = 0xFFFFFFFF;
+
+    std::vector<uint32_t> words;
+    std::vector<Decoded> decoded; // One per word, then the end-of-text record and bad-target records
+    std::vector<uint32_t> recordAt; // Record starting at each halfword address, or noRecord
+    std::vector<uint8_t> dataMemory;
+    uint32_t regs[33] = {};       // x0..x31 plus a write-only sink for rd == x0
+    bool profiling = false;
+    std::vector<uint64_t> counts; // Runs of each record, when profiling
+
+    void predecode();
+    template <bool profile>
+    SimulationResult execute(uint64_t maxSteps);
+};
+
+const char* stopReasonName(StopReason reason);
+
+#endif
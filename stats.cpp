@@ -0,0 +1,127 @@
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <sys/resource.h>
+#include "stats.h"
+
+using namespace std;
+
+static atomic<uint64_t> allocations{0};
+static atomic<uint64_t> allocatedBytes{0};
+
+// Count every heap allocation made through operator new
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    if (void* memory = malloc(size == 0 ? 1 : size)) return memory;
+    throw bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+    free(memory);
+}
+
+uint64_t allocationCount() {
+    return allocations.load(memory_order_relaxed);
+}
+
+uint64_t allocatedByteCount() {
+    return allocatedBytes.load(memory_order_relaxed);
+}
+
+static long peakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // Kilobytes on Linux
+}
+
+PhaseTimer::PhaseTimer(AssemblyStats* stats, const char* name) : stats(stats) {
+    if (stats == nullptr) return;
+    this->name = name;
+    allocationsAtStart = allocationCount();
+    bytesAtStart = allocatedByteCount();
+    start = chrono::steady_clock::now();
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (stats == nullptr) return;
+    PhaseStats phase;
+    phase.name = name;
+    phase.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    phase.allocations = allocationCount() - allocationsAtStart;
+    phase.allocatedBytes = allocatedByteCount() - bytesAtStart;
+    phase.peakRssKb = peakRssKb();
+    stats->phases.push_back(phase);
+}
+
+void AssemblyStats::clear() {
+    phases.clear();
+    lines = instructions = dataBytes = bytesWritten = cachedBlocks = parsedBlocks = peakPending = pooledBytes = 0;
+}
+
+static double totalSeconds(const vector<PhaseStats>& phases) {
+    double total = 0;
+    for (const PhaseStats& phase : phases) total += phase.seconds;
+    return total;
+}
+
+static double perSecond(uint64_t count, double seconds) {
+    return seconds > 0 ? count / seconds : 0;
+}
+
+void AssemblyStats::report(ostream& out) const {
+    double total = totalSeconds(phases);
+    ios::fmtflags flags = out.flags();
+    out << fixed << setprecision(3);
+    out << left << setw(12) << "phase" << right << setw(12) << "time (ms)" << setw(12) << "allocs"
+        << setw(14) << "alloc KiB" << setw(16) << "peak RSS KiB" << "\n";
+    for (const PhaseStats& phase : phases) {
+        out << left << setw(12) << phase.name << right << setw(12) << phase.seconds * 1e3 << setw(12)
+            << phase.allocations << setw(14) << phase.allocatedBytes / 1024 << setw(16) << phase.peakRssKb << "\n";
+    }
+    out << setprecision(0);
+    out << "total " << setprecision(3) << total * 1e3 << " ms; " << setprecision(0)
+        << lines << " lines (" << perSecond(lines, total) << " lines/s); "
+        << instructions << " instructions (" << perSecond(instructions, total) << " instr/s); "
+        << dataBytes << " data bytes; " << bytesWritten << " bytes written\n";
+    if (cachedBlocks + parsedBlocks > 0) {
+        out << "cache: " << cachedBlocks << " blocks reused, " << parsedBlocks << " parsed\n";
+    }
+    if (peakPending > 0) out << "stream: at most " << peakPending << " forward references pending\n";
+    if (pooledBytes > 0) out << "pool: " << pooledBytes << " read-only data bytes saved\n";
+    out.flags(flags);
+}
+
+void AssemblyStats::reportJson(ostream& out) const {
+    double total = totalSeconds(phases);
+    out << "{\"phases\":[";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const PhaseStats& phase = phases[i];
+        out << (i ? "," : "") << "{\"name\":\"" << phase.name << "\",\"seconds\":" << phase.seconds
+            << ",\"allocations\":" << phase.allocations << ",\"allocated_bytes\":" << phase.allocatedBytes
+            << ",\"peak_rss_kb\":" << phase.peakRssKb << "}";
+    }
+    out << "],\"total_seconds\":" << total << ",\"lines\":" << lines
+        << ",\"lines_per_second\":" << perSecond(lines, total) << ",\"instructions\":" << instructions
+        << ",\"instructions_per_second\":" << perSecond(instructions, total) << ",\"data_bytes\":" << dataBytes
+        << ",\"bytes_written\":" << bytesWritten << ",\"cached_blocks\":" << cachedBlocks
+        << ",\"parsed_blocks\":" << parsedBlocks << ",\"peak_pending\":" << peakPending
+        << ",\"pooled_bytes\":" << pooledBytes << "}\n";
+}
@@ -0,0 +1,54 @@
+#ifndef STATS_H
+#define STATS_H
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-phase measurements for --stats
+struct PhaseStats {
+    std::string name;
+    double seconds = 0;
+    uint64_t allocations = 0;    // operator new calls during the phase
+    uint64_t allocatedBytes = 0;
+    long peakRssKb = 0;          // Process peak RSS at the end of the phase
+};
+
+// Collects timings and counters for one assembly run
+class AssemblyStats {
+public:
+    std::vector<PhaseStats> phases;
+    uint64_t lines = 0;
+    uint64_t instructions = 0;
+    uint64_t dataBytes = 0;
+    uint64_t bytesWritten = 0;
+    uint64_t cachedBlocks = 0; // Incremental mode: source blocks replayed from the cache
+    uint64_t parsedBlocks = 0; // and parsed because they changed
+    uint64_t peakPending = 0;  // Streaming: most forward references outstanding at once
+    uint64_t pooledBytes = 0;  // Read-only data bytes saved by pooling
+
+    void clear();
+    void report(std::ostream& out) const;
+    void reportJson(std::ostream& out) const;
+};
+
+// Times the enclosing scope as one phase; does nothing when stats is null
+class PhaseTimer {
+private:
+    AssemblyStats* stats;
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+    uint64_t allocationsAtStart = 0;
+    uint64_t bytesAtStart = 0;
+
+public:
+    PhaseTimer(AssemblyStats* stats, const char* name);
+    ~PhaseTimer();
+};
+
+// Process-wide allocation counters, maintained by the replaced operator new
+uint64_t allocationCount();
+uint64_t allocatedByteCount();
+
+#endif
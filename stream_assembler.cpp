@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "stream_assembler.h"
+#include "converter.h"
+#include "lexer.h"
+#include "parser.h"
+#include "program.h"
+#include "relaxation.h"
+
+using namespace std;
+
+namespace {
+
+constexpr size_t readSize = 1 << 20;
+constexpr size_t chunkSize = 1 << 20;
+constexpr uint8_t idAuipc = instructionId("auipc");
+
+// Output file written in large chunks, whose bytes can still be patched
+// after they were appended: in the buffer while they are there, in the file
+// once written, which therefore has to be seekable
+class PatchableOutput {
+private:
+    int fd = -1;
+    bool seekable = false;
+    bool ok = true;
+    uint64_t bufferStart = 0; // File offset of buffer[0]
+
+    void writeAll(const char* bytes, size_t count) {
+        while (count > 0 && ok) {
+            ssize_t written = ::write(fd, bytes, count);
+            if (written <= 0) ok = false;
+            else bytes += written, count -= written;
+        }
+    }
+
+public:
+    string buffer; // Appended to directly
+
+    ~PatchableOutput() {
+        if (fd > STDOUT_FILENO) ::close(fd);
+    }
+
+    bool open(const string& filename) {
+        fd = filename == "-" ? STDOUT_FILENO : ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        struct stat info;
+        seekable = fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        buffer.reserve(chunkSize + 4096);
+        return fd >= 0;
+    }
+
+    bool isSeekable() const { return seekable; }
+    uint64_t size() const { return bufferStart + buffer.size(); }
+
+    void patch(uint64_t offset, const string& bytes) {
+        if (offset >= bufferStart) {
+            memcpy(&buffer[offset - bufferStart], bytes.data(), bytes.size());
+        } else if (pwrite(fd, bytes.data(), bytes.size(), static_cast<off_t>(offset)) !=
+                   static_cast<ssize_t>(bytes.size())) {
+            ok = false;
+        }
+    }
+
+    // Write out the bytes before limit once there is at least a chunk of
+    // them, and at least as many as would have to be moved down after it
+    void flush(uint64_t limit, bool force) {
+        size_t count = static_cast<size_t>(limit - bufferStart);
+        if (!force && (count < chunkSize || count < buffer.size() - count)) return;
+        writeAll(buffer.data(), count);
+        buffer.erase(0, count);
+        bufferStart += count;
+    }
+
+    bool good() const { return ok; }
+};
+
+// An instruction written before the label it names was defined
+struct Fixup {
+    uint64_t offset;      // Of its listing line or binary word
+    uint32_t address;
+    int64_t pairAddress;  // See resolveImmediate
+    uint8_t id, rd, rs1, rs2;
+    int32_t addend;
+    uint32_t lineNumber;
+    string statement;     // To format the listing line again
+};
+
+class StreamAssembler {
+public:
+    StreamAssembler(SymbolTable& symbolTable, DataSegment& data, OutputFormat format, bool annotate)
+        : symbolTable(symbolTable), data(data), format(format), annotate(annotate) {}
+
+    PatchableOutput output;
+    size_t instructions = 0;
+    size_t peakPending = 0;
+
+    bool parseLines(Lexer& lexer, Program& program);
+    bool finish();
+
+private:
+    SymbolTable& symbolTable;
+    DataSegment& data;
+    OutputFormat format;
+    bool annotate;
+    bool inData = false;
+    uint32_t address = 0;                 // Of the next instruction
+    SymbolId lastAuipc = noSymbolId;      // Symbol of the instruction just written, if it is an auipc
+    unordered_map<SymbolId, vector<Fixup>> pending;
+    size_t pendingCount = 0;
+    multiset<uint64_t> pendingOffsets;    // Only for unseekable output, where flushing stops at the first
+
+    bool encode(const Fixup& fixup, bool resolve, int64_t target, string_view statement, uint32_t& word) const;
+    void write(const Fixup& fixup, uint32_t word, string_view statement);
+    bool emit(const Program& program, size_t index, uint32_t lineNumber);
+    bool defineLabel(SymbolId symbol);
+};
+
+// Encode an instruction, with its label operand resolved to target when
+// resolve is set. Nothing is relaxed, so a branch or jump that cannot reach
+// its target is an error.
+bool StreamAssembler::encode(const Fixup& fixup, bool resolve, int64_t target, string_view statement,
+                             uint32_t& word) const {
+    const InstructionDesc& desc = instructionTable[fixup.id];
+    int32_t immediate = fixup.addend;
+    if (resolve) {
+        immediate = resolveImmediate(fixup.id, fixup.address, target, fixup.pairAddress);
+        int bits = desc.format == Format::SB ? 13 : desc.format == Format::UJ ? 21 : 0;
+        if (bits != 0 && (immediate < -(1 << (bits - 1)) || immediate >= (1 << (bits - 1)))) {
+            cerr << "Error: Target of '" << statement << "' on line " << fixup.lineNumber
+                 << " is out of range; branches are not relaxed when streaming" << endl;
+            return false;
+        }
+    }
+    word = encodeInstruction(desc, fixup.rd, fixup.rs1, fixup.rs2, immediate);
+    return true;
+}
+
+// Append an instruction's listing line or word, or overwrite it once a
+// pending label operand has been resolved
+void StreamAssembler::write(const Fixup& fixup, uint32_t word, string_view statement) {
+    string bytes;
+    string& out = fixup.offset == output.size() ? output.buffer : bytes;
+    if (format == OutputFormat::Text) {
+        appendListingLine(out, fixup.address, word, instructionTable[fixup.id].format, statement, annotate);
+    } else {
+        for (int shift = 0; shift < 32; shift += 8) out.push_back(static_cast<char>(word >> shift));
+    }
+    if (&out == &bytes) output.patch(fixup.offset, bytes);
+}
+
+bool StreamAssembler::emit(const Program& program, size_t index, uint32_t lineNumber) {
+    SymbolId symbol = program.symbols[index];
+    bool paired = program.modifiers[index] == Modifier::PcrelLo;
+    if (paired && symbol != lastAuipc) {
+        cerr << "Error: %pcrel_lo in '" << program.text(index) << "' on line " << lineNumber
+             << " does not follow an auipc of the same label" << endl;
+        return false;
+    }
+    Fixup fixup{output.size(), address, paired ? int64_t(address) - 4 : -1, program.ids[index], program.rd[index],
+                program.rs1[index], program.rs2[index], program.immediates[index], lineNumber, string()};
+    lastAuipc = program.ids[index] == idAuipc ? symbol : noSymbolId;
+    address += 4;
+    instructions++;
+
+    uint32_t word = 0;
+    if (symbol == noSymbolId || symbolTable.isLabel(symbol)) {
+        bool resolve = symbol != noSymbolId;
+        int64_t target = resolve ? int64_t(symbolTable.address(symbol)) + fixup.addend : 0;
+        if (!encode(fixup, resolve, target, program.text(index), word)) return false;
+        write(fixup, word, program.text(index));
+        return true;
+    }
+
+    // Forward reference: write it with the addend alone for now, which takes
+    // the same space, and remember where
+    encode(fixup, false, 0, program.text(index), word);
+    write(fixup, word, program.text(index));
+    fixup.statement = string(program.text(index));
+    if (!output.isSeekable()) pendingOffsets.insert(fixup.offset);
+    pending[symbol].push_back(move(fixup));
+    peakPending = max(peakPending, ++pendingCount);
+    return true;
+}
+
+// Patch every instruction waiting for symbol, which has just been defined
+bool StreamAssembler::defineLabel(SymbolId symbol) {
+    auto waiting = pending.find(symbol);
+    if (waiting == pending.end()) return true;
+    for (const Fixup& fixup : waiting->second) {
+        uint32_t word;
+        if (!encode(fixup, true, int64_t(symbolTable.address(symbol)) + fixup.addend, fixup.statement, word)) {
+            return false;
+        }
+        write(fixup, word, fixup.statement);
+        if (!output.isSeekable()) pendingOffsets.erase(pendingOffsets.find(fixup.offset));
+    }
+    pendingCount -= waiting->second.size();
+    pending.erase(waiting);
+    return true;
+}
+
+// The line loop of parseLines (see parser.cpp), with each instruction
+// emitted as soon as it has been parsed
+bool StreamAssembler::parseLines(Lexer& lexer, Program& program) {
+    SourceLine line;
+    while (lexer.next(line)) {
+        if (line.hasLabel) {
+            if (line.label.empty() || isdigit(static_cast<unsigned char>(line.label[0]))) {
+                cerr << "Error: Invalid label '" << line.label << "' - Labels cannot start with numbers!" << endl;
+                return false;
+            }
+            SymbolId existing = symbolTable.find(line.label);
+            if (existing != noSymbolId && symbolTable.isLabel(existing)) {
+                cerr << "Error: Duplicate label '" << line.label << "' on line " << line.lineNumber << endl;
+                return false;
+            }
+            if (!defineLabel(symbolTable.addLabel(line.label, inData ? data.address() : address))) return false;
+        }
+        if (line.mnemonic.empty()) continue;
+
+        if (line.mnemonic[0] == '.') {
+            if (!processDirective(line, symbolTable, data, inData)) return false;
+            continue;
+        }
+        size_t first = program.size();
+        if (!parseInstructionFields(line, program, symbolTable)) return false;
+        for (size_t i = first; i < program.size(); i++) {
+            if (!emit(program, i, line.lineNumber)) return false;
+        }
+    }
+    output.flush(output.isSeekable() || pendingOffsets.empty() ? output.size() : *pendingOffsets.begin(), false);
+    return output.good();
+}
+
+// Report labels that were never defined, then append the data image
+bool StreamAssembler::finish() {
+    if (pendingCount > 0) {
+        // In order of first use
+        vector<pair<uint64_t, SymbolId>> undefined;
+        for (const auto& waiting : pending) undefined.emplace_back(waiting.second.front().offset, waiting.first);
+        sort(undefined.begin(), undefined.end());
+        for (const auto& symbol : undefined) {
+            cerr << "Error: Label '" << symbolTable.name(symbol.second) << "' not found in symbol table." << endl;
+        }
+        return false;
+    }
+    if (format == OutputFormat::Text) {
+        uint32_t dataAddress = DataSegment::baseAddress;
+        for (size_t i = 0; i < data.size(); i++) {
+            appendDataLine(output.buffer, dataAddress++, data.data()[i]);
+            output.flush(output.size(), false);
+        }
+    }
+    output.flush(output.size(), true);
+    return output.good();
+}
+
+} // namespace
+
+bool assembleStream(const string& inputFilename, const string& outputFilename, OutputFormat format, bool annotate,
+                    SymbolTable& symbolTable, DataSegment& data, AssemblyStats* stats) {
+    PhaseTimer timer(stats, "stream");
+    if (format == OutputFormat::Elf || (format == OutputFormat::Binary && outputFilename == "-")) {
+        cerr << "Error: Streaming writes a .mc listing, or binary images to a named file" << endl;
+        return false;
+    }
+    int input = inputFilename == "-" ? STDIN_FILENO : ::open(inputFilename.c_str(), O_RDONLY);
+    if (input < 0) {
+        cerr << "Error: Could not open file " << inputFilename << endl;
+        return false;
+    }
+    symbolTable.clear();
+    data.clear();
+    StreamAssembler assembler(symbolTable, data, format, annotate);
+    if (!assembler.output.open(outputFilename)) {
+        cerr << "Error: Could not write output file " << outputFilename << endl;
+        if (input != STDIN_FILENO) close(input);
+        return false;
+    }
+
+    // Source is parsed a chunk of whole lines at a time; a partial last line
+    // is carried over to the next read
+    string source;
+    Program program;
+    uint32_t lines = 0;
+    bool ok = true, end = false, partialLine = false;
+    while (ok && !end) {
+        size_t kept = source.size();
+        source.resize(kept + readSize);
+        ssize_t bytesRead = read(input, &source[kept], readSize);
+        if (bytesRead < 0 && errno == EINTR) {
+            source.resize(kept);
+            continue;
+        }
+        if (bytesRead < 0) {
+            cerr << "Error: Could not read " << inputFilename << endl;
+            ok = false;
+        }
+        source.resize(kept + max<ssize_t>(bytesRead, 0));
+        end = bytesRead <= 0;
+        size_t newline = source.rfind('\n');
+        if (!end && newline == string::npos) continue;
+        size_t length = end ? source.size() : newline + 1;
+
+        string_view chunk(source.data(), length);
+        Lexer lexer(chunk, lines);
+        program.clear();
+        program.setSource(chunk);
+        ok = ok && assembler.parseLines(lexer, program);
+        lines += static_cast<uint32_t>(count(chunk.begin(), chunk.end(), '\n'));
+        partialLine = !chunk.empty() && chunk.back() != '\n';
+        source.erase(0, length);
+    }
+    if (input != STDIN_FILENO) close(input);
+    ok = ok && assembler.finish();
+
+    if (ok && format == OutputFormat::Binary) {
+        ofstream dataFile(outputFilename + ".data", ios::binary);
+        dataFile.write(reinterpret_cast<const char*>(data.data()), data.size());
+        ok = dataFile.good();
+    }
+    if (!ok) {
+        cerr << "Error: Failed in streaming assembly." << endl;
+        return false;
+    }
+    if (stats != nullptr) {
+        stats->lines += lines + partialLine;
+        stats->instructions += assembler.instructions;
+        stats->dataBytes += data.size();
+        stats->bytesWritten += assembler.output.size() + (format == OutputFormat::Binary ? data.size() : 0);
+        stats->peakPending = max<uint64_t>(stats->peakPending, assembler.peakPending);
+    }
+    return true;
+}
@@ -0,0 +1,26 @@
+#ifndef STREAM_ASSEMBLER_H
+#define STREAM_ASSEMBLER_H
+#include <string>
+#include "symbol_table.h"
+#include "data_segment.h"
+#include "output_writer.h"
+#include "stats.h"
+
+// Streaming assembly of input of any length, such as a code generator
+// writing to a pipe. The source is read in chunks and every instruction is
+// encoded and written out as soon as it is parsed. An instruction naming a
+// label that is not defined yet is written as a zero word and kept pending;
+// when the label is defined it is encoded and patched into the output, in
+// place when the output is a file and in the write buffer when it is a pipe,
+// which then holds output back from the oldest pending instruction. Memory
+// grows with the outstanding forward references, the labels and the data
+// image, not with the number of instructions.
+//
+// The layout is fixed as instructions stream out, so branches and jumps are
+// not relaxed and must reach their targets in their short form, and RV32C
+// forms are not used. The output is a .mc listing, with the data bytes after
+// the instructions, or raw binary images. "-" names stdin or stdout.
+bool assembleStream(const std::string& inputFilename, const std::string& outputFilename, OutputFormat format,
+                    bool annotate, SymbolTable& symbolTable, DataSegment& data, AssemblyStats* stats);
+
+#endif
@@ -1,59 +1,159 @@
-#include <map>
+#include <cstring>
 #include <string>
-#include <iostream>
-#include <vector>
 #include "symbol_table.h"
 
 using namespace std;
 
-// Add a label and its address to the symbol table
-void SymbolTable::addLabel(const string& label, uint32_t address) {
-    table[label] = address;
+// Copy text into the current block, starting a new block when it is full
+string_view StringArena::store(string_view text) {
+    if (used + text.size() > blockSize) {
+        size_t size = text.size() > blockSize ? text.size() : blockSize;
+        blocks.emplace_back(new char[size]);
+        used = 0;
+    }
+    char* destination = blocks.back().get() + used;
+    memcpy(destination, text.data(), text.size());
+    used += text.size();
+    return string_view(destination, text.size());
 }
 
-// Retrieve the address of a label
-uint32_t SymbolTable::getAddress(const string& label) const {
-    auto it = table.find(label);
-    if (it != table.end()) {
-        return it->second;
+void StringArena::clear() {
+    if (blocks.size() > 1) blocks.resize(1);
+    used = blocks.empty() ? blockSize : 0;
+}
+
+SymbolTable::SymbolTable() : slots(1024, 0) {}
+
+// FNV-1a over the name bytes
+uint32_t SymbolTable::hashName(string_view name) {
+    uint32_t hash = 2166136261u;
+    for (char c : name) hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    return hash;
+}
+
+// Double the slot table and reinsert every symbol using its stored hash
+void SymbolTable::grow() {
+    vector<uint32_t> larger(slots.size() * 2, 0);
+    size_t mask = larger.size() - 1;
+    for (SymbolId id = 0; id < symbols.size(); id++) {
+        if (symbols[id].flags & flagUnlisted) continue;
+        size_t slot = symbols[id].hash & mask;
+        while (larger[slot] != 0) slot = (slot + 1) & mask;
+        larger[slot] = id + 1;
     }
-    return 0xFFFFFFFF; // Return an invalid address if label not found
+    slots.swap(larger);
+}
+
+SymbolId SymbolTable::find(string_view name) const {
+    uint32_t hash = hashName(name);
+    size_t mask = slots.size() - 1;
+    for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+        const Symbol& symbol = symbols[slots[slot] - 1];
+        if (symbol.hash == hash && symbol.name == name) return slots[slot] - 1;
+    }
+    return noSymbolId;
+}
+
+SymbolId SymbolTable::intern(string_view name) {
+    uint32_t hash = hashName(name);
+    size_t mask = slots.size() - 1;
+    size_t slot = hash & mask;
+    for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+        const Symbol& symbol = symbols[slots[slot] - 1];
+        if (symbol.hash == hash && symbol.name == name) return slots[slot] - 1;
+    }
+
+    SymbolId id = static_cast<SymbolId>(symbols.size());
+    symbols.push_back({names.store(name), hash, 0xFFFFFFFF, 0, 0});
+    slots[slot] = id + 1;
+    if (symbols.size() * 2 > slots.size()) grow(); // Keep the load factor at or below 1/2
+    return id;
 }
 
-// Add a data value at a specific address
-void SymbolTable::addData(uint32_t address, int val) {
-    dataSection[address] = val;
+void SymbolTable::reserve(size_t count) {
+    symbols.reserve(count);
+    while (count * 2 > slots.size()) grow();
 }
 
-// Retrieve a data value from a specific address
-int SymbolTable::getData(uint32_t address) const {
-    auto it = dataSection.find(address);
-    if (it != dataSection.end()) {
-        return it->second;
+void SymbolTable::clear() {
+    if (symbols.size() * 8 < slots.size()) {
+        // Few symbols in a large table: zero just their slots
+        size_t mask = slots.size() - 1;
+        for (SymbolId id = 0; id < symbols.size(); id++) {
+            if (symbols[id].flags & flagUnlisted) continue;
+            size_t slot = symbols[id].hash & mask;
+            while (slots[slot] != id + 1) slot = (slot + 1) & mask;
+            slots[slot] = 0;
+        }
+    } else {
+        fill(slots.begin(), slots.end(), 0);
     }
-    return -1; // Default value if data not found
+    symbols.clear();
+    names.clear();
+    constantsDigest = 0;
+}
+
+// Add a label and its address to the symbol table
+SymbolId SymbolTable::addLabel(string_view label, uint32_t address) {
+    SymbolId id = intern(label);
+    addLabel(id, address);
+    return id;
+}
+
+void SymbolTable::addLabel(SymbolId id, uint32_t address) {
+    symbols[id].address = address;
+    symbols[id].flags |= flagLabel;
+}
+
+SymbolId SymbolTable::addLocalLabel(string_view name, uint32_t address) {
+    SymbolId id = static_cast<SymbolId>(symbols.size());
+    symbols.push_back({names.store(name), hashName(name), address, 0, flagLabel | flagUnlisted});
+    return id;
+}
+
+// Retrieve the address of a label
+uint32_t SymbolTable::getAddress(string_view label) const {
+    SymbolId id = find(label);
+    if (id != noSymbolId && isLabel(id)) {
+        return symbols[id].address;
+    }
+    return 0xFFFFFFFF; // Return an invalid address if label not found
 }
 
 // Add a global symbol
-void SymbolTable::addGlobal(const string& symbol) {
-    globalSymbols.insert(symbol);
+void SymbolTable::addGlobal(string_view symbol) {
+    symbols[intern(symbol)].flags |= flagGlobal;
 }
 
 // Check if a symbol is global
-bool SymbolTable::isGlobal(const string& symbol) const {
-    return globalSymbols.find(symbol) != globalSymbols.end();
+bool SymbolTable::isGlobal(string_view symbol) const {
+    SymbolId id = find(symbol);
+    return id != noSymbolId && isGlobal(id);
 }
 
 // Add a constant definition
-void SymbolTable::addConstant(const string& name, int value) {
-    constants[name] = value;
+void SymbolTable::addConstant(string_view name, int value) {
+    Symbol& symbol = symbols[intern(name)];
+    symbol.constant = value;
+    symbol.flags |= flagConstant;
+    constantsDigest = (constantsDigest ^ symbol.hash ^ (static_cast<uint64_t>(static_cast<uint32_t>(value)) << 32)) *
+                      0x100000001B3ull;
 }
 
 // Retrieve a constant value
-int SymbolTable::getConstant(const string& name) const {
-    auto it = constants.find(name);
-    if (it != constants.end()) {
-        return it->second;
+int SymbolTable::getConstant(string_view name) const {
+    SymbolId id = find(name);
+    if (id != noSymbolId && (symbols[id].flags & flagConstant)) {
+        return symbols[id].constant;
     }
     return 0; // Default if constant not found
 }
+
+bool SymbolTable::findConstant(string_view name, int32_t& value) const {
+    SymbolId id = find(name);
+    if (id != noSymbolId && isConstant(id)) {
+        value = symbols[id].constant;
+        return true;
+    }
+    return outer != nullptr && outer->findConstant(name, value);
+}
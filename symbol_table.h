@@ -1,27 +1,91 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
-#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <cstdint>
-#include <set>
+#include <vector>
+
+// Symbols are referred to by a dense integer id everywhere past the parser
+using SymbolId = uint32_t;
+constexpr SymbolId noSymbolId = 0xFFFFFFFF;
+
+// Append-only storage for symbol names. Names are copied into large blocks
+// that never move, so the returned views stay valid for the arena's lifetime.
+class StringArena {
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t used = blockSize;
+
+public:
+    std::string_view store(std::string_view text);
+    void clear();
+};
 
 class SymbolTable {
 private:
-    std::map<std::string, uint32_t> table; // Label -> Address
-    std::map<uint32_t, int> dataSection;  // Address -> Data Value
-    std::set<std::string> globalSymbols;  // Global symbols
-    std::map<std::string, int> constants; // Constants
+    enum : uint8_t { flagLabel = 1, flagGlobal = 2, flagConstant = 4, flagUnlisted = 8 };
+
+    struct Symbol {
+        std::string_view name; // Owned by names
+        uint32_t hash;
+        uint32_t address;
+        int32_t constant;
+        uint8_t flags;
+    };
+
+    StringArena names;
+    std::vector<Symbol> symbols;  // Indexed by SymbolId
+    std::vector<uint32_t> slots;  // Open-addressing table of SymbolId + 1 (0 = empty)
+    const SymbolTable* outer = nullptr;
+    uint64_t constantsDigest = 0;
+
+    static uint32_t hashName(std::string_view name);
+    void grow();
 
 public:
-    void addLabel(const std::string& label, uint32_t address);
-    void addData(uint32_t address, int val);
-    int getData(uint32_t address) const;
-    void addGlobal(const std::string& symbol);
-    bool isGlobal(const std::string& symbol) const;
-    void addConstant(const std::string& name, int value);
-    int getConstant(const std::string& name) const;
-    uint32_t getAddress(const std::string& label) const;
+    SymbolTable();
+
+    // Id of name, creating an undefined symbol on first use
+    SymbolId intern(std::string_view name);
+    // Id of name, or noSymbolId if it was never interned
+    SymbolId find(std::string_view name) const;
+
+    SymbolId addLabel(std::string_view label, uint32_t address);
+    void addLabel(SymbolId id, uint32_t address);
+    // Add a label that lookups by name never return: a label local to one
+    // linked module, whose name other modules may use too
+    SymbolId addLocalLabel(std::string_view name, uint32_t address);
+    void addGlobal(std::string_view symbol);
+    bool isGlobal(std::string_view symbol) const;
+    void addConstant(std::string_view name, int value);
+    int getConstant(std::string_view name) const;
+    // Value of a constant defined here or in the outer table
+    bool findConstant(std::string_view name, int32_t& value) const;
+    // Make the constants of table visible through findConstant, for parsing
+    // part of a file into a separate table
+    void setOuterScope(const SymbolTable* table) { outer = table; }
+    // Changes with every constant definition, so that a cached parse can
+    // tell whether the constants it saw still hold
+    uint64_t constantsHash() const { return constantsDigest; }
+    uint32_t getAddress(std::string_view label) const;
+
+    // Accessors by id
+    size_t size() const { return symbols.size(); }
+    std::string_view name(SymbolId id) const { return symbols[id].name; }
+    bool isLabel(SymbolId id) const { return symbols[id].flags & flagLabel; }
+    bool isGlobal(SymbolId id) const { return symbols[id].flags & flagGlobal; }
+    bool isConstant(SymbolId id) const { return symbols[id].flags & flagConstant; }
+    int32_t constant(SymbolId id) const { return symbols[id].constant; }
+    uint32_t address(SymbolId id) const { return symbols[id].address; }
+    void setAddress(SymbolId id, uint32_t address) { symbols[id].address = address; }
+
+    // Make room for count symbols without rehashing
+    void reserve(size_t count);
+    // Forget every symbol but keep the allocated storage
+    void clear();
 };
 
 #endif
@@ -0,0 +1,162 @@
+#include "verifier.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include "assembler.h"
+#include "compressed.h"
+#include "converter.h"
+#include "disassembler.h"
+#include "encoder.h"
+#include "parallel.h"
+
+using namespace std;
+
+// Mismatches printed before the rest are only counted
+static constexpr size_t maxReportedMismatches = 10;
+
+// The fields the parser recorded for one instruction, in decoded form
+static DecodedInstruction expectedFields(const Program& program, size_t index) {
+    DecodedInstruction expected;
+    expected.desc = &program.desc(index);
+    expected.rd = program.rd[index];
+    expected.rs1 = program.rs1[index];
+    expected.rs2 = program.rs2[index];
+    expected.imm = program.immediates[index];
+    return expected;
+}
+
+static bool fieldsMatch(const DecodedInstruction& expected, const DecodedInstruction& decoded) {
+    if (decoded.desc != expected.desc || decoded.rd != expected.rd || decoded.rs1 != expected.rs1 ||
+        decoded.rs2 != expected.rs2) {
+        return false;
+    }
+    int32_t imm = expected.imm;
+    if (expected.desc->format == Format::U) {
+        // lui/auipc take the 20-bit field, written either signed or unsigned
+        if (imm < -(1 << 19) || imm > 0xFFFFF) return false;
+        imm = signExtend(static_cast<uint32_t>(imm) & 0xFFFFF, 20);
+    }
+    return decoded.imm == imm;
+}
+
+// An RV32C word may stand for a commuted or equivalent instruction (c.mv is
+// add rd, x0, rs for mv's addi rd, rs, 0), so fields are not compared
+// directly: the parsed fields must compress to this word, and the word must
+// expand to an instruction that compresses back to it
+static bool compressedMatches(const Program& program, size_t index, uint32_t word) {
+    uint16_t half = static_cast<uint16_t>(word);
+    if (compressInstruction(program.ids[index], program.rd[index], program.rs1[index], program.rs2[index],
+                            program.immediates[index]) != half) {
+        return false;
+    }
+    DecodedInstruction decoded;
+    uint32_t expanded = expandCompressed(half);
+    return expanded != 0 && decodeInstruction(expanded, decoded) &&
+           compressInstruction(static_cast<uint8_t>(decoded.desc - instructionTable), decoded.rd, decoded.rs1,
+                               decoded.rs2, decoded.imm) == half;
+}
+
+size_t verifyEncoding(const Program& program, const vector<uint32_t>& code, unsigned jobs) {
+    // Each chunk keeps its own mismatch list so the report stays in address order
+    size_t chunkCount = parallelChunkCount(program.size(), jobs, 1 << 16);
+    vector<vector<size_t>> mismatches(chunkCount);
+    parallelChunks(program.size(), jobs, 1 << 16, [&](size_t chunk, size_t begin, size_t end) {
+        DecodedInstruction decoded;
+        for (size_t i = begin; i < end; i++) {
+            bool ok = i < code.size() && (isCompressedWord(code[i]) ? compressedMatches(program, i, code[i])
+                                                                    : decodeInstruction(code[i], decoded) &&
+                                                                      fieldsMatch(expectedFields(program, i), decoded));
+            if (!ok) mismatches[chunk].push_back(i);
+        }
+    });
+
+    size_t total = 0;
+    for (const vector<size_t>& list : mismatches) {
+        for (size_t index : list) {
+            if (total++ >= maxReportedMismatches) continue;
+            uint32_t word = index < code.size() ? code[index] : 0;
+            string expected;
+            appendDisassembly(expectedFields(program, index), expected);
+            cerr << "Error: Encoding mismatch at 0x" << hex << program.address(index) << ": 0x" << word << dec
+                 << " decodes to '" << disassemble(word) << "', expected '" << expected << "'";
+            if (!program.text(index).empty()) cerr << " from '" << program.text(index) << "'";
+            cerr << endl;
+        }
+    }
+    if (total > maxReportedMismatches) cerr << "... " << total - maxReportedMismatches << " more mismatches" << endl;
+    return total;
+}
+
+// A random instruction with every field inside its encodable range
+static void addRandomInstruction(Program& program, mt19937& rng) {
+    uint8_t id = static_cast<uint8_t>(rng() % instructionCount);
+    const InstructionDesc& desc = instructionTable[id];
+    uint32_t bits = rng();
+    uint8_t rd = bits & 0x1F, rs1 = (bits >> 5) & 0x1F, rs2 = (bits >> 10) & 0x1F;
+    int32_t imm = signExtend(rng(), 21);
+    switch (desc.format) {
+        case Format::R: imm = 0; break;
+        case Format::I: rs2 = 0; imm = signExtend(imm, 12); break;
+        case Format::S: rd = 0; imm = signExtend(imm, 12); break;
+        case Format::SB: rd = 0; imm = signExtend(imm, 13) & ~1; break;
+        case Format::U: rs1 = rs2 = 0; imm = signExtend(imm, 20); break;
+        case Format::UJ: rs1 = rs2 = 0; imm &= ~1; break;
+    }
+    program.add(id, rd, rs1, rs2, imm, noSymbolId, Modifier::None, string_view());
+}
+
+static double millionsPerSecond(size_t count, chrono::steady_clock::time_point start) {
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return seconds > 0 ? count / seconds / 1e6 : 0;
+}
+
+bool verifyRandomInstructions(size_t count, uint32_t seed, unsigned jobs) {
+    Program program;
+    program.reserve(count);
+    mt19937 rng(seed);
+    for (size_t i = 0; i < count; i++) addRandomInstruction(program, rng);
+
+    // Encode, then decode every word and compare its fields
+    vector<uint32_t> code;
+    auto start = chrono::steady_clock::now();
+    encodeProgram(program, code, jobs);
+    double encodeRate = millionsPerSecond(count, start);
+
+    start = chrono::steady_clock::now();
+    size_t mismatches = verifyEncoding(program, code, jobs);
+    double decodeRate = millionsPerSecond(count, start);
+
+    // Disassemble to source text and assemble it again
+    start = chrono::steady_clock::now();
+    string source;
+    source.reserve(count * 24);
+    DecodedInstruction decoded;
+    for (uint32_t word : code) {
+        if (decodeInstruction(word, decoded)) appendDisassembly(decoded, source);
+        else source += "add x0, x0, x0"; // Already reported above; keeps the line count aligned
+        source += '\n';
+    }
+    Assembler assembler;
+    assembler.options.jobs = jobs;
+    bool reassembled = assembler.assemble(source);
+    double textRate = millionsPerSecond(count, start);
+
+    size_t textMismatches = 0;
+    if (reassembled) {
+        const vector<uint32_t>& again = assembler.code();
+        for (size_t i = 0; i < count; i++) {
+            if (i < again.size() && again[i] == code[i]) continue;
+            if (textMismatches++ < maxReportedMismatches) {
+                cerr << "Error: Text round trip changed 0x" << hex << code[i] << " ('" << disassemble(code[i])
+                     << "') into 0x" << (i < again.size() ? again[i] : 0) << dec << endl;
+            }
+        }
+    }
+
+    cout << "Verified " << count << " random instructions (seed " << seed << "): encode " << encodeRate
+         << " M/s, decode+compare " << decodeRate << " M/s, text round trip " << textRate << " M/s" << endl;
+    cout << mismatches << " field mismatches, " << (reassembled ? to_string(textMismatches) : "failed")
+         << " text round-trip mismatches" << endl;
+    return mismatches == 0 && reassembled && textMismatches == 0;
+}
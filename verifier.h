@@ -0,0 +1,19 @@
+#ifndef VERIFIER_H
+#define VERIFIER_H
+#include <cstdint>
+#include <vector>
+#include "program.h"
+
+// Round-trip checks for the encoder. Every emitted word is decoded with the
+// disassembler and compared field by field against the parsed instruction.
+
+// Check code against program on up to jobs threads (0 = all cores); reports
+// the first mismatches to cerr and returns how many words disagree
+size_t verifyEncoding(const Program& program, const std::vector<uint32_t>& code, unsigned jobs);
+
+// Differential test over count random instructions: encode, decode and
+// compare, then disassemble to text, reassemble it and compare the words.
+// Prints throughput for each stage; returns false on any mismatch.
+bool verifyRandomInstructions(size_t count, uint32_t seed, unsigned jobs);
+
+#endif